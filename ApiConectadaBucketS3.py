@@ -1,6 +1,6 @@
 import os
-import io
-from flask import Flask, request, jsonify, send_file
+import hashlib
+from flask import Flask, Response, request, jsonify, stream_with_context
 import boto3
 from botocore.exceptions import NoCredentialsError, ClientError
 
@@ -43,12 +43,10 @@ def upload_backup():
     s3_file_name = uploaded_file.filename
 
     try:
-        # Leer el contenido del archivo en un objeto de bytes en memoria
-        file_content = uploaded_file.read()
-        file_object = io.BytesIO(file_content)
-
+        # Se pasa el stream del archivo recibido tal cual: upload_fileobj lo lee por partes,
+        # sin cargar todo el ZIP en memoria.
         s3.upload_fileobj(
-            file_object,        # El objeto de archivo en memoria
+            uploaded_file.stream, # El archivo recibido
             S3_BUCKET,          # Tu bucket S3
             s3_file_name,       # El nombre que tendrá el archivo en S3
             ExtraArgs={'ContentType': 'application/zip'} # Asegura el tipo MIME correcto
@@ -76,6 +74,99 @@ def upload_backup():
         print(f"Ocurrió un error inesperado durante la subida a S3: {e}")
         return jsonify({"success": False, "message": f"Error interno del servidor: {str(e)}"}), 500
 
+def s3_error_response(e, accion):
+    """Respuesta JSON para los errores de S3 de los endpoints de subida multiparte."""
+    if isinstance(e, NoCredentialsError):
+        print("Error: Las credenciales de AWS no están configuradas o son inválidas.")
+        return jsonify({"success": False, "message": "Error de credenciales de AWS. Verifica tu configuración."}), 500
+    if isinstance(e, ClientError):
+        error_code = e.response.get("Error", {}).get("Code")
+        error_message = e.response.get("Error", {}).get("Message")
+        print(f"Error de cliente de S3 ({error_code}) al {accion}: {error_message}")
+        status = 404 if error_code == 'NoSuchUpload' else 500
+        return jsonify({"success": False, "message": f"Error al {accion}: {error_message} (Código: {error_code})"}), status
+    print(f"Ocurrió un error inesperado al {accion}: {e}")
+    return jsonify({"success": False, "message": f"Error interno del servidor: {str(e)}"}), 500
+
+
+# --- Subida multiparte reanudable ---
+# El cliente C++ corta el ZIP en partes de tamaño fijo y sube varias a la vez:
+#   POST /upload-backup/init                      {"filename"} -> {"upload_id"}
+#   PUT  /upload-backup/part?upload_id&filename&part=N  (cuerpo: la parte, cabecera X-Part-SHA256) -> {"etag"}
+#   GET  /upload-backup/parts?upload_id&filename  -> partes ya recibidas (para retomar)
+#   POST /upload-backup/complete                  {"upload_id", "filename", "parts": [{"part", "etag"}]}
+# Cada parte se reenvía a S3 como parte de una subida multiparte, así que el servidor
+# nunca tiene en memoria más de una parte por petición.
+
+@app.route('/upload-backup/init', methods=['POST'])
+def upload_backup_init():
+    data = request.get_json(silent=True) or {}
+    filename = data.get('filename', '')
+    if not filename.lower().endswith('.zip'):
+        return jsonify({"success": False, "message": "Tipo de archivo no permitido. Solo se aceptan archivos ZIP."}), 400
+    try:
+        response = s3.create_multipart_upload(Bucket=S3_BUCKET, Key=filename, ContentType='application/zip')
+        return jsonify({"success": True, "upload_id": response['UploadId']}), 200
+    except Exception as e:
+        return s3_error_response(e, "iniciar la subida")
+
+
+@app.route('/upload-backup/part', methods=['PUT'])
+def upload_backup_part():
+    upload_id = request.args.get('upload_id', '')
+    filename = request.args.get('filename', '')
+    part_number = request.args.get('part', type=int)
+    if not upload_id or not filename or not part_number or not 1 <= part_number <= 10000:
+        return jsonify({"success": False, "message": "Parámetros de la parte inválidos."}), 400
+
+    body = request.get_data(cache=False)
+    expected = request.headers.get('X-Part-SHA256', '').lower()
+    if expected and hashlib.sha256(body).hexdigest() != expected:
+        return jsonify({"success": False, "message": f"La parte {part_number} llegó corrupta (SHA-256 distinto)."}), 400
+    try:
+        response = s3.upload_part(Bucket=S3_BUCKET, Key=filename, UploadId=upload_id,
+                                  PartNumber=part_number, Body=body)
+        return jsonify({"success": True, "etag": response['ETag']}), 200
+    except Exception as e:
+        return s3_error_response(e, f"subir la parte {part_number}")
+
+
+@app.route('/upload-backup/parts', methods=['GET'])
+def upload_backup_parts():
+    upload_id = request.args.get('upload_id', '')
+    filename = request.args.get('filename', '')
+    try:
+        parts = []
+        paginator = s3.get_paginator('list_parts')
+        for page in paginator.paginate(Bucket=S3_BUCKET, Key=filename, UploadId=upload_id):
+            for part in page.get('Parts', []):
+                parts.append({"part": part['PartNumber'], "etag": part['ETag'], "size": part['Size']})
+        return jsonify({"success": True, "parts": parts}), 200
+    except Exception as e:
+        return s3_error_response(e, "listar las partes")
+
+
+@app.route('/upload-backup/complete', methods=['POST'])
+def upload_backup_complete():
+    data = request.get_json(silent=True) or {}
+    upload_id = data.get('upload_id', '')
+    filename = data.get('filename', '')
+    parts = [{"PartNumber": p['part'], "ETag": p['etag']} for p in data.get('parts', [])]
+    try:
+        s3.complete_multipart_upload(Bucket=S3_BUCKET, Key=filename, UploadId=upload_id,
+                                     MultipartUpload={"Parts": parts})
+        s3_url = f"https://{S3_BUCKET}.s3.{s3.meta.region_name}.amazonaws.com/{filename}"
+        print(f"Archivo subido exitosamente a S3 en {len(parts)} partes: {s3_url}")
+        return jsonify({
+            "success": True,
+            "message": "Archivo ZIP subido exitosamente a S3.",
+            "s3_url": s3_url,
+            "filename_on_s3": filename
+        }), 200
+    except Exception as e:
+        return s3_error_response(e, "completar la subida")
+
+
 @app.route('/list-backups', methods=['GET'])
 def list_backups():
     """
@@ -104,26 +195,38 @@ def list_backups():
         print(f"Ocurrió un error inesperado al listar archivos de S3: {e}")
         return jsonify({"success": False, "message": f"Error interno del servidor: {str(e)}"}), 500
 
-@app.route('/download-backup/<path:filename>', methods=['GET'])
+@app.route('/download-backup/<path:filename>', methods=['GET', 'HEAD'])
 def download_backup(filename):
     """
     Endpoint para descargar un archivo específico del bucket S3.
     El <path:filename> permite que el nombre del archivo incluya barras (subdirectorios).
+    Acepta HEAD (tamaño del archivo) y la cabecera Range, así el cliente C++ puede pedir
+    varios rangos de bytes en paralelo. El cuerpo se reenvía desde S3 por partes, sin
+    cargar el archivo completo en memoria.
     """
+    headers = {"Accept-Ranges": "bytes"}
     try:
-        # Descargar el archivo de S3 a un objeto de bytes en memoria
-        file_object = io.BytesIO()
-        s3.download_fileobj(S3_BUCKET, filename, file_object)
-        file_object.seek(0) # Mover el puntero al inicio del archivo para la lectura
-
-        print(f"Archivo '{filename}' descargado de S3.")
-        # Servir el archivo al cliente C++
-        return send_file(
-            file_object,
-            mimetype='application/zip', # O el mimetype real del archivo si es variable
-            as_attachment=True,
-            download_name=filename # Nombre del archivo cuando se descarga
-        )
+        if request.method == 'HEAD':
+            head = s3.head_object(Bucket=S3_BUCKET, Key=filename)
+            headers["Content-Length"] = str(head['ContentLength'])
+            return Response(status=200, headers=headers, mimetype='application/zip')
+
+        extra = {}
+        range_header = request.headers.get('Range')
+        if range_header:
+            extra['Range'] = range_header
+        s3_object = s3.get_object(Bucket=S3_BUCKET, Key=filename, **extra)
+        headers["Content-Length"] = str(s3_object['ContentLength'])
+        headers["Content-Disposition"] = f"attachment; filename={os.path.basename(filename)}"
+        status = 200
+        if 'ContentRange' in s3_object:
+            headers["Content-Range"] = s3_object['ContentRange']
+            status = 206
+
+        print(f"Archivo '{filename}' descargado de S3{' (' + range_header + ')' if range_header else ''}.")
+        # Servir el archivo al cliente C++ a medida que llega de S3
+        return Response(stream_with_context(s3_object['Body'].iter_chunks(1024 * 1024)),
+                        status=status, headers=headers, mimetype='application/zip')
 
     except NoCredentialsError:
         print("Error: Las credenciales de AWS no están configuradas o son inválidas.")
@@ -132,8 +235,11 @@ def download_backup(filename):
         error_code = e.response.get("Error", {}).get("Code")
         error_message = e.response.get("Error", {}).get("Message")
         print(f"Error de cliente de S3 ({error_code}): {error_message}")
-        if error_code == 'NoSuchKey':
+        # head_object devuelve el código HTTP ('404') en lugar de 'NoSuchKey'
+        if error_code in ('NoSuchKey', '404'):
             return jsonify({"success": False, "message": f"Archivo '{filename}' no encontrado en S3."}), 404
+        if error_code == 'InvalidRange':
+            return jsonify({"success": False, "message": f"Rango no válido para '{filename}'."}), 416
         return jsonify({"success": False, "message": f"Error al descargar de S3: {error_message} (Código: {error_code})"}), 500
     except Exception as e:
         print(f"Ocurrió un error inesperado durante la descarga de S3: {e}")
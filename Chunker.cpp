@@ -0,0 +1,94 @@
+#include "Chunker.h"
+#include <openssl/sha.h>
+#include <unistd.h>
+#include <array>
+#include <cstring>
+#include <vector>
+
+// Máscaras de FastCDC: antes del tamaño promedio se exigen más bits a cero (cortes menos
+// probables) y después menos, para que los tamaños se concentren alrededor del promedio.
+static constexpr uint64_t MASK_SMALL = 0xa5695a5695a00000ull; // 22 bits
+static constexpr uint64_t MASK_LARGE = 0xa5294a5294a00000ull; // 18 bits
+
+// Tabla gear: 256 valores pseudoaleatorios fijos. Debe ser siempre la misma para que los
+// cortes (y por tanto la deduplicación) se mantengan entre ejecuciones.
+static const std::array<uint64_t, 256>& gear_table() {
+    static const std::array<uint64_t, 256> table = [] {
+        std::array<uint64_t, 256> t{};
+        uint64_t state = 0x9E3779B97F4A7C15ull;
+        for (auto& value : t) { // splitmix64
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            value = z ^ (z >> 31);
+        }
+        return t;
+    }();
+    return table;
+}
+
+size_t find_chunk_boundary(const unsigned char* data, size_t len) {
+    if (len <= CHUNK_MIN_SIZE) {
+        return len;
+    }
+    if (len > CHUNK_MAX_SIZE) {
+        len = CHUNK_MAX_SIZE;
+    }
+    size_t normal = len < CHUNK_AVG_SIZE ? len : CHUNK_AVG_SIZE;
+
+    const auto& gear = gear_table();
+    uint64_t fingerprint = 0;
+    size_t i = CHUNK_MIN_SIZE;
+    for (; i < normal; ++i) {
+        fingerprint = (fingerprint << 1) + gear[data[i]];
+        if (!(fingerprint & MASK_SMALL)) return i + 1;
+    }
+    for (; i < len; ++i) {
+        fingerprint = (fingerprint << 1) + gear[data[i]];
+        if (!(fingerprint & MASK_LARGE)) return i + 1;
+    }
+    return len;
+}
+
+bool chunk_file(int fd, const std::function<bool(const unsigned char* data, size_t len)>& on_chunk) {
+    // El buffer siempre tiene al menos un chunk máximo disponible (salvo al final del archivo).
+    std::vector<unsigned char> buffer(2 * CHUNK_MAX_SIZE);
+    size_t start = 0, end = 0;
+    bool eof = false;
+    while (true) {
+        if (!eof && end - start < CHUNK_MAX_SIZE) {
+            std::memmove(buffer.data(), buffer.data() + start, end - start);
+            end -= start;
+            start = 0;
+            while (end < buffer.size()) {
+                ssize_t n = read(fd, buffer.data() + end, buffer.size() - end);
+                if (n < 0) return false;
+                if (n == 0) {
+                    eof = true;
+                    break;
+                }
+                end += n;
+            }
+        }
+        if (start == end) {
+            return true;
+        }
+        size_t cut = find_chunk_boundary(buffer.data() + start, end - start);
+        if (!on_chunk(buffer.data() + start, cut)) {
+            return false;
+        }
+        start += cut;
+    }
+}
+
+std::string sha256_hex(const unsigned char* data, size_t len) {
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(data, len, digest);
+    static const char hex[] = "0123456789abcdef";
+    std::string out(2 * SHA256_DIGEST_LENGTH, '0');
+    for (int i = 0; i < SHA256_DIGEST_LENGTH; ++i) {
+        out[2 * i] = hex[digest[i] >> 4];
+        out[2 * i + 1] = hex[digest[i] & 0xF];
+    }
+    return out;
+}
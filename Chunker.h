@@ -0,0 +1,26 @@
+#ifndef CHUNKER_H
+#define CHUNKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Tamaños de los chunks (FastCDC con normalización): mínimo, promedio buscado y máximo.
+constexpr size_t CHUNK_MIN_SIZE = 512 * 1024;
+constexpr size_t CHUNK_AVG_SIZE = 1024 * 1024;
+constexpr size_t CHUNK_MAX_SIZE = 8 * 1024 * 1024;
+
+// Posición de corte del primer chunk de 'data' según el hash gear de FastCDC.
+// Como el corte depende solo del contenido, insertar bytes en un archivo cambia
+// únicamente los chunks cercanos a la modificación.
+size_t find_chunk_boundary(const unsigned char* data, size_t len);
+
+// Lee 'fd' hasta el final y llama a 'on_chunk' con cada chunk. Devuelve false si hay
+// un error de lectura o si 'on_chunk' devuelve false.
+bool chunk_file(int fd, const std::function<bool(const unsigned char* data, size_t len)>& on_chunk);
+
+// SHA-256 en hexadecimal: nombre de un chunk dentro del repositorio.
+std::string sha256_hex(const unsigned char* data, size_t len);
+
+#endif // CHUNKER_H
@@ -1,11 +1,18 @@
 #include "CloudStorage.h"
-#include "utils.h" // Para show_message, compress_folder, copy_directory, decompress_file, etc.
+#include "utils.h" // Para show_message, compress_folders, decompress_file, etc.
+#include "StreamBuffer.h"
+#include "MultipartUpload.h"
+#include "RangedDownload.h"
+#include "ConnectionPool.h"
+#include "Chunker.h" // sha256_hex para nombrar los diarios de subida
+#include "Scheduler.h" // Para comprimir mientras se sube
 #include <filesystem>
 #include <iostream>
 #include <ctime>     // Para std::time
-#include <fstream>   // Para std::ifstream (leer el archivo ZIP)
+#include <cstdlib>   // Para std::getenv
 #include <string>    // Para std::string
 #include <vector>    // Para std::vector
+#include <functional>
 #include <nlohmann/json.hpp> // Para parsear la respuesta JSON de Flask
 
 // Incluye la librería cURL para realizar peticiones HTTP
@@ -14,6 +21,12 @@
 namespace fs = std::filesystem;
 using json = nlohmann::json; // Alias para nlohmann::json
 
+// URL base de la API Flask que sube los respaldos a S3.
+static const char* FLASK_API_BASE_URL = "http://127.0.0.1:5000";
+
+// Capacidad del buffer entre el compresor y la subida: lo máximo que el ZIP se adelanta a la red.
+static constexpr size_t UPLOAD_BUFFER_SIZE = 16 * 1024 * 1024;
+
 // Función de callback para cURL que se usa para escribir la respuesta del servidor
 // en un std::string.
 size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp) {
@@ -21,191 +34,233 @@ size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp) {
     return size * nmemb;
 }
 
-// Función de callback para cURL para escribir datos binarios directamente a un archivo
-size_t WriteFileCallback(void *ptr, size_t size, size_t nmemb, FILE *stream) {
-    size_t written = fwrite(ptr, size, nmemb, stream);
-    return written;
+// Función de callback para cURL que entrega el cuerpo de la subida desde el StreamBuffer
+// que va llenando el compresor. Si la compresión falló se aborta la transferencia.
+static size_t StreamReadCallback(char *buffer, size_t size, size_t nitems, void *userp) {
+    StreamBuffer* stream = static_cast<StreamBuffer*>(userp);
+    size_t n = stream->read(buffer, size * nitems);
+    if (n == 0 && stream->failed()) {
+        return CURL_READFUNC_ABORT;
+    }
+    return n;
 }
 
-
+// Datos locales de los respaldos en la nube (manifiesto, firmas y diarios de subida):
+// $XDG_CACHE_HOME/backup_tool (o ~/.cache/backup_tool).
+static fs::path cloud_cache_dir() {
+    const char* cache = std::getenv("XDG_CACHE_HOME");
+    fs::path base;
+    if (cache && *cache) {
+        base = cache;
+    } else {
+        const char* home = std::getenv("HOME");
+        base = fs::path(home ? home : ".") / ".cache";
+    }
+    return base / "backup_tool";
+}
 
 bool CloudStorage::validate() {
     show_message("Validando configuración para la subida/descarga a la Nube (via Flask API)...");
     return true;
 }
 
+// Comprime las carpetas en una tarea del carril Io hacia 'sink' mientras 'upload' (en este
+// hilo) envía los datos. 'on_done' se llama al terminar la compresión con su resultado.
+static bool compress_while_uploading(const std::vector<std::string>& folders, const CodecOptions& codec,
+                                     IncrementalState& incremental, BackupStats& stats, const ZipSink& sink,
+                                     const std::function<void(bool)>& on_done, const std::function<bool()>& upload) {
+    bool compress_ok = false;
+    TaskGroup producer(Lane::Io);
+    producer.run([&]() {
+        try {
+            compress_ok = compress_folders(folders, sink, codec, &stats, &incremental);
+        } catch (const std::exception& e) {
+            std::cerr << "Error generando el archivo ZIP: " << e.what() << std::endl;
+        }
+        on_done(compress_ok);
+    });
+    bool uploaded = upload();
+    producer.wait();
+    return uploaded && compress_ok;
+}
+
+// Subida en una sola petición POST a /upload-backup, para servidores sin subida multiparte.
+// El cuerpo es 'multipart/form-data' (lo que Flask espera en 'request.files') y, como el tamaño
+// no se conoce hasta terminar de comprimir, cURL usa transferencia chunked y pide los datos a
+// StreamReadCallback a medida que los envía.
+static bool upload_single_request(const std::vector<std::string>& folders, const CodecOptions& codec,
+                                  IncrementalState& incremental, const std::string& file_to_upload_name,
+                                  BackupStats& stats, std::string& error) {
+    PooledCurl handle; // Sesión de cURL del pool de conexiones
+    CURL *curl = handle.get();
+    if (!curl) {
+        error = "Error: No se pudo inicializar cURL.";
+        return false;
+    }
+    std::string readBuffer; // Buffer para almacenar la respuesta del servidor Flask
+    CURLcode res = CURLE_OK; // Código de resultado de las operaciones de cURL
+
+    curl_easy_setopt(curl, CURLOPT_URL, (std::string(FLASK_API_BASE_URL) + "/upload-backup").c_str());
+    // Configura la función de callback para procesar la respuesta del servidor.
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
+
+    // "backup_file" es el nombre del campo que Flask buscará en 'request.files'.
+    StreamBuffer stream(UPLOAD_BUFFER_SIZE);
+    curl_mime* mime = curl_mime_init(curl);
+    curl_mimepart* part = curl_mime_addpart(mime);
+    curl_mime_name(part, "backup_file");
+    curl_mime_filename(part, file_to_upload_name.c_str()); // Nombre del archivo que Flask verá
+    curl_mime_type(part, "application/zip"); // Tipo MIME del archivo
+    curl_mime_data_cb(part, -1, StreamReadCallback, nullptr, nullptr, &stream);
+    curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
+
+    ZipSink sink = [&stream](const void* data, size_t len) { return stream.write(data, len); };
+    bool ok = compress_while_uploading(folders, codec, incremental, stats, sink,
+        [&stream](bool compress_ok) { stream.close(compress_ok); },
+        [&]() {
+            res = curl_easy_perform(curl);
+            // Si cURL terminó antes (error de red), el compresor deja de esperar espacio en el buffer.
+            stream.cancel();
+            return res == CURLE_OK;
+        });
+    curl_mime_free(mime);
+
+    // Un fallo de la compresión aborta la transferencia desde StreamReadCallback; un fallo
+    // de red cancela la compresión, así que el error de cURL es el que se informa.
+    if (res == CURLE_ABORTED_BY_CALLBACK || (res == CURLE_OK && !ok)) {
+        error = "Error: El archivo ZIP no se generó correctamente; la subida se canceló.";
+        return false;
+    }
+    if (res != CURLE_OK) {
+        error = "Error al enviar el archivo via cURL: " + std::string(curl_easy_strerror(res));
+        return false;
+    }
+    std::cout << "Respuesta de Flask:\n" << readBuffer << std::endl;
+    try {
+        auto response_json = json::parse(readBuffer);
+        if (response_json.contains("success") && response_json["success"].get<bool>()) {
+            return true;
+        }
+        error = "Flask API respondió con un error: " +
+                (response_json.contains("message") ? response_json["message"].get<std::string>() : "Error desconocido.");
+    } catch (const std::exception& e) {
+        error = "Error al parsear la respuesta JSON de Flask: " + std::string(e.what());
+    }
+    return false;
+}
+
 // Implementación del método backup para CloudStorage.
 // Este método se encarga de:
-// 1. Copiar las carpetas seleccionadas a un directorio temporal.
-// 2. Comprimir el directorio temporal en un archivo ZIP.
-// 3. Enviar el archivo ZIP a la API de Flask usando una petición HTTP POST.
-// 4. Limpiar los archivos temporales después de la subida.
+// 1. Comprimir las carpetas seleccionadas en una tarea aparte, sin crear un ZIP temporal.
+// 2. Subir el ZIP a la API de Flask a medida que se genera, en partes (de 16 MB al principio) que viajan en
+//    paralelo y que se anotan en un diario para poder retomar una subida interrumpida.
+// 3. Si el servidor no tiene los endpoints multiparte, enviarlo en una sola petición chunked.
 bool CloudStorage::backup(const std::vector<std::string>& folders) {
-    show_message("Iniciando subida a la Nube via Flask API...\n(Generando archivo local primero)");
+    show_message("Iniciando subida a la Nube via Flask API...");
 
-    // Define la ruta del directorio temporal donde se preparará el respaldo.
-    // Se utiliza std::filesystem::temp_directory_path() para obtener una ruta temporal segura.
-    fs::path temp_backup_dir = fs::temp_directory_path() / "temp_cloud_backup";
-    fs::path zip_file_path; // Ruta completa del archivo ZIP temporal.
+    // El manifiesto del último respaldo subido se guarda en la caché del usuario, ya que
+    // en la nube solo quedan los ZIP.
+    fs::path manifest_path = cloud_cache_dir() / "cloud.manifest";
+    IncrementalState incremental;
+    prepare_incremental(manifest_path, choose_backup_mode(), incremental);
 
     // Genera un nombre único para el archivo ZIP basado en la marca de tiempo actual.
-    std::string backup_name = "respaldo_flask_" + std::to_string(std::time(nullptr));
+    // Los incrementales llevan '_inc_' para distinguirlos al restaurar.
+    std::string backup_name = std::string(incremental.incremental ? "respaldo_flask_inc_" : "respaldo_flask_") +
+                              std::to_string(std::time(nullptr));
     std::string file_to_upload_name = backup_name + ".zip"; // Nombre final del archivo ZIP.
 
-    try {
-        // Elimina el directorio temporal si ya existe para asegurar una limpieza.
-        if (fs::exists(temp_backup_dir)) {
-            fs::remove_all(temp_backup_dir);
-        }
-        // Crea el directorio temporal.
-        fs::create_directories(temp_backup_dir);
-
-        // Copia todas las carpetas seleccionadas por el usuario al directorio temporal.
-        //'copy_directory' está definida en 'utils.h'.
-        for (const std::string& folder : folders) {
-            fs::path source_path(folder);
-            fs::path dest_path = temp_backup_dir / source_path.filename();
-            if (!copy_directory(source_path, dest_path)) {
-                show_message("Error copiando una carpeta a la ubicación temporal: " + folder);
-                fs::remove_all(temp_backup_dir); // Limpiar si hay un error
-                return false;
-            }
-        }
-
-        // Comprime el contenido del directorio temporal en un archivo ZIP.
-        //'compress_folder' está definida en 'utils.h'.
-        zip_file_path = temp_backup_dir.string() + ".zip";
-        compress_folder(temp_backup_dir, temp_backup_dir); // compress_folder crea un ZIP junto a la carpeta
-
-        // Verifica si el archivo ZIP se creó correctamente.
-        if (!fs::exists(zip_file_path)) {
-            show_message("Error: El archivo ZIP no se creó correctamente en la ruta temporal.");
-            fs::remove_all(temp_backup_dir); // Limpiar si hay un error
+    for (const std::string& folder : folders) {
+        if (!fs::is_directory(fs::path(folder))) {
+            show_message("Carpeta no válida: " + folder);
             return false;
         }
-
-    } catch (const std::exception& e) {
-        // Captura cualquier excepción durante la preparación del archivo ZIP.
-        show_message("Error preparando el archivo ZIP local: " + std::string(e.what()));
-        // Intenta limpiar los archivos temporales en caso de error.
-        if (fs::exists(temp_backup_dir)) {
-            fs::remove_all(temp_backup_dir);
-        }
-        if (fs::exists(zip_file_path)) {
-            fs::remove(zip_file_path);
-        }
-        return false;
     }
-
-    // --- po aqui intentamos realizar la petición HTTP POST a la API de Flask ---
-    CURL *curl; // Puntero a la sesión de cURL
-    CURLcode res; // Código de resultado de las operaciones de cURL
-    std::string readBuffer; // Buffer para almacenar la respuesta del servidor Flask
-
-    // Inicializa la librería cURL. Esto debe hacerse una vez por aplicación.
-    curl_global_init(CURL_GLOBAL_ALL);
-    // Crea una nueva sesión de cURL.
-    curl = curl_easy_init();
-
+    CodecOptions codec = choose_codec();
+    set_cache_policy(choose_cache_policy());
+
+    // El diario de la subida se identifica por lo que se respalda: repetir el mismo respaldo
+    // tras una interrupción retoma la subida pendiente.
+    std::string job;
+    for (const auto& folder : folders) job += folder + '\n';
+    job += codec_name(codec.type) + ' ' + std::to_string(codec.level) + (incremental.incremental ? " inc" : " full");
+    fs::path journal_path = cloud_cache_dir() / "uploads" /
+        (sha256_hex(reinterpret_cast<const unsigned char*>(job.data()), job.size()) + ".journal");
+
+    BackupStats stats;
+    std::string error;
     bool upload_success = false; // Bandera para indicar el éxito de la subida.
+    MultipartUpload upload(FLASK_API_BASE_URL, journal_path);
+    if (upload.begin(file_to_upload_name, error)) {
+        std::cout << "Enviando " << upload.filename() << " a la API Flask mientras se comprime..." << std::endl;
+        ZipSink sink = [&upload](const void* data, size_t len) { return upload.write(data, len); };
+        upload_success = compress_while_uploading(folders, codec, incremental, stats, sink,
+            [&upload](bool compress_ok) { upload.close(compress_ok); },
+            [&]() { return upload.run(error); });
+    } else if (upload.unsupported()) {
+        std::cout << "La API Flask no admite subidas multiparte; se envía en una sola petición." << std::endl;
+        upload_success = upload_single_request(folders, codec, incremental, file_to_upload_name, stats, error);
+    }
 
-    if (curl) {
-        // Define la URL de tu aplicación Flask.
-        // Reemplazariamos la dirección IP o nombre de host correcto si la app de Flask no está en el mismo pc.
-        std::string flask_api_url = "http://127.0.0.1:5000/upload-backup"; // en este caso, la app Flask corre en el mismo pc.
-
-        // Configura la URL a la que se enviará la petición.
-        curl_easy_setopt(curl, CURLOPT_URL, flask_api_url.c_str());
-        // Configura la función de callback para procesar la respuesta del servidor.
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        // Pasa el buffer donde se almacenará la respuesta a la función de callback.
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-
-        // Abre el archivo ZIP para lectura en modo binario.
-        std::ifstream file_stream(zip_file_path, std::ios::binary | std::ios::ate);
-        if (!file_stream.is_open()) {
-            show_message("Error: No se pudo abrir el archivo ZIP para enviar.");
-        } else {
-            // Obtiene el tamaño del archivo para la petición.
-            long file_size = file_stream.tellg();
-            file_stream.seekg(0, std::ios::beg); // Vuelve al inicio del archivo.
-
-            // Configura la petición para enviar el archivo como 'multipart/form-data'.
-            // Esto es lo que Flask espera cuando accedes a 'request.files'.
-            struct curl_httppost *formpost = NULL;
-            struct curl_httppost *lastptr = NULL;
-
-            // Añade el archivo ZIP al formulario HTTP.
-            // "backup_file" es el nombre del campo que Flask buscará en 'request.files'.
-            curl_formadd(&formpost,
-                         &lastptr,
-                         CURLFORM_COPYNAME, "backup_file",
-                         CURLFORM_FILE, zip_file_path.string().c_str(), // Ruta del archivo local a enviar
-                         CURLFORM_FILENAME, file_to_upload_name.c_str(), // Nombre del archivo que Flask verá
-                         CURLFORM_CONTENTTYPE, "application/zip", // Tipo MIME del archivo
-                         CURLFORM_END);
-
-            // Establece el formulario HTTP para la petición POST.
-            curl_easy_setopt(curl, CURLOPT_HTTPPOST, formpost);
-
-            show_message("Enviando " + zip_file_path.filename().string() + " a la API Flask...");
-            // Realiza la petición HTTP.
-            res = curl_easy_perform(curl);
-
-            if (res != CURLE_OK) {
-                // Si hay un error en la petición cURL, muestra el mensaje de error.
-                std::string curl_error = curl_easy_strerror(res);
-                show_message("Error al enviar el archivo via cURL: " + curl_error);
-            } else {
-                // Si la petición fue exitosa, procesa la respuesta de Flask.
-                std::cout << "Respuesta de Flask:\n" << readBuffer << std::endl;
-                // Aquí, se asume que Flask devolverá un JSON con "success": true
-                // Para un análisis más robusto, usarías una librería JSON para C++.
-                try {
-                    auto response_json = json::parse(readBuffer);
-                    if (response_json.contains("success") && response_json["success"].get<bool>()) {
-                        show_message("Archivo enviado y procesado por Flask exitosamente.");
-                        upload_success = true;
-                    } else {
-                        std::string error_msg = response_json.contains("message") ? response_json["message"].get<std::string>() : "Error desconocido.";
-                        show_message("Flask API respondió con un error: " + error_msg);
-                    }
-                } catch (const json::parse_error& e) {
-                    show_message("Error al parsear la respuesta JSON de Flask: " + std::string(e.what()));
-                } catch (const std::exception& e) {
-                    show_message("Error inesperado al procesar la respuesta de Flask: " + std::string(e.what()));
-                }
-            }
-
-            // Limpia los recursos del formulario HTTP.
-            curl_formfree(formpost);
-            // Cierra el stream del archivo.
-            file_stream.close();
-        }
-        // Limpia la sesión de cURL.
-        curl_easy_cleanup(curl);
+    if (upload_success) {
+        std::cout << describe_stats(stats) << std::endl;
+        show_message("Archivo enviado y procesado por Flask exitosamente.");
     } else {
-        show_message("Error: No se pudo inicializar cURL.");
+        show_message(error.empty() ? "Error durante la subida a la API Flask." : error);
     }
-    // Desinicializa la librería cURL. Esto debe hacerse una vez al final de la aplicación.
-    curl_global_cleanup();
-
-    // --- Sección para la limpieza de archivos temporales ---
-    try {
-        // Elimina el directorio temporal y el archivo ZIP generado.
-        if (fs::exists(temp_backup_dir)) {
-            fs::remove_all(temp_backup_dir);
-        }
-        if (fs::exists(zip_file_path)) {
-            fs::remove(zip_file_path);
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "Advertencia: No se pudieron eliminar los archivos temporales: " << e.what() << std::endl;
+    // El manifiesto solo avanza si el servidor confirmó el respaldo; si no, el próximo
+    // incremental vuelve a incluir estos cambios.
+    if (upload_success) {
+        std::error_code ec;
+        fs::create_directories(manifest_path.parent_path(), ec);
+        commit_incremental(manifest_path, incremental);
     }
 
     return upload_success;
 }
 
+// Capacidad del buffer entre la descarga de un respaldo y su extracción.
+static constexpr size_t RESTORE_BUFFER_SIZE = 16 * 1024 * 1024;
+
+// Restaura los respaldos en el orden de la lista: un incremental se aplica después del
+// respaldo sobre el que se hizo. Cada uno se descarga por rangos en una tarea del carril Io
+// mientras este hilo lo extrae; los bytes pasan en orden por un StreamBuffer acotado, sin archivo temporal.
+// Devuelve los errores.
+static std::vector<std::string> restore_backups(const std::string& base_url, const std::vector<std::string>& backups,
+                                                const fs::path& destination) {
+    RangedDownloader downloader;
+    std::vector<std::string> errors;
+    for (const auto& backup_filename : backups) {
+        std::cout << "Descargando y descomprimiendo respaldo: " << backup_filename << "..." << std::endl;
+        StreamBuffer stream(RESTORE_BUFFER_SIZE);
+        std::string download_error;
+        TaskGroup download(Lane::Io);
+        download.run([&] {
+            DownloadSink sink = [&stream](const void* data, size_t len) { return stream.write(data, len); };
+            bool ok = downloader.download(base_url + "/download-backup/" + backup_filename, sink, download_error);
+            stream.close(ok);
+        });
+
+        bool extracted = decompress_stream(
+            [&stream](void* out, size_t max) { return stream.read(out, max); }, destination);
+        // Si la descarga cerró con error antes de que terminara la extracción, el fallo es de red.
+        bool download_failed = stream.failed();
+        // Si la extracción se detuvo antes del final, la descarga deja de esperar espacio en el buffer.
+        stream.cancel();
+        download.wait();
+
+        if (download_failed) {
+            errors.push_back("Error al descargar " + backup_filename + ": " + download_error);
+        } else if (!extracted) {
+            errors.push_back("Error al descomprimir " + backup_filename + ".");
+        } else {
+            std::cout << "Restauración de " << backup_filename << " completada." << std::endl;
+        }
+    }
+    return errors;
+}
+
 // Implementación del método restore para CloudStorage.
 // Este método se encarga de:
 // 1. Obtener la lista de respaldos disponibles de la API de Flask.
@@ -216,17 +271,14 @@ bool CloudStorage::backup(const std::vector<std::string>& folders) {
 bool CloudStorage::restore() {
     show_message("Iniciando proceso de restauración desde la Nube (via Flask API)...");
 
-    CURL *curl;
     CURLcode res;
     std::string readBuffer; // Para almacenar la respuesta JSON de listado
-    std::string flask_api_base_url = "http://127.0.0.1:5000"; // URL base de tu API Flask
-
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl = curl_easy_init();
+    std::string flask_api_base_url = FLASK_API_BASE_URL; // URL base de tu API Flask
 
+    PooledCurl handle; // Sesión de cURL del pool de conexiones
+    CURL *curl = handle.get();
     if (!curl) {
         show_message("Error: No se pudo inicializar cURL para la restauración.");
-        curl_global_cleanup();
         return false;
     }
 
@@ -241,41 +293,30 @@ bool CloudStorage::restore() {
 
     if (res != CURLE_OK) {
         show_message("Error al listar respaldos de la Nube: " + std::string(curl_easy_strerror(res)));
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
         return false;
     }
 
     try {
         auto response_json = json::parse(readBuffer);
         if (response_json.contains("success") && response_json["success"].get<bool>() && response_json.contains("files")) {
-            #pragma omp parallel for
             for (const auto& file : response_json["files"]) {
                 available_backups.push_back(file.get<std::string>());
             }
         } else {
             std::string error_msg = response_json.contains("message") ? response_json["message"].get<std::string>() : "Error desconocido al listar.";
             show_message("Flask API respondió con un error al listar respaldos: " + error_msg);
-            curl_easy_cleanup(curl);
-            curl_global_cleanup();
             return false;
         }
     } catch (const json::parse_error& e) {
         show_message("Error al parsear la respuesta JSON de listado: " + std::string(e.what()));
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
         return false;
     } catch (const std::exception& e) {
         show_message("Error inesperado al procesar la lista de respaldos: " + std::string(e.what()));
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
         return false;
     }
 
     if (available_backups.empty()) {
         show_message("No se encontraron respaldos en la Nube.");
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
         return true; // No hay nada que restaurar, pero no es un error fatal.
     }
 
@@ -284,8 +325,6 @@ bool CloudStorage::restore() {
 
     if (selected_backups.empty()) {
         show_message("No se seleccionaron archivos para restaurar.");
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
         return true;
     }
 
@@ -293,8 +332,6 @@ bool CloudStorage::restore() {
     std::string destination_folder_str = ask_restore_destination_folder();
     if (destination_folder_str.empty()) {
         show_message("No se seleccionó una carpeta de destino para la restauración.");
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
         return false;
     }
     fs::path destination_folder(destination_folder_str);
@@ -304,59 +341,21 @@ bool CloudStorage::restore() {
         fs::create_directories(destination_folder);
     } catch (const std::exception& e) {
         show_message("Error creando la carpeta de destino: " + std::string(e.what()));
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
         return false;
     }
 
     // --- 4. y 5. Descargar y Descomprimir cada respaldo seleccionado ---
-    bool all_restored_successfully = true;
-    #pragma omp parallel for
-    for (const auto& backup_filename : selected_backups) {
-        show_message("Descargando respaldo: " + backup_filename + "...");
-        std::string download_url = flask_api_base_url + "/download-backup/" + backup_filename;
-        fs::path temp_download_path = fs::temp_directory_path() / backup_filename;
-
-        // Configurar cURL para descargar el archivo directamente a un archivo local
-        FILE* fp = fopen(temp_download_path.string().c_str(), "wb");
-        if (!fp) {
-            show_message("Error: No se pudo crear archivo temporal para descarga: " + temp_download_path.string());
-            all_restored_successfully = false;
-            continue;
-        }
-
-        curl_easy_setopt(curl, CURLOPT_URL, download_url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteFileCallback); // Usar el callback para escribir a archivo
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp); // Pasar el puntero al archivo
-
-        res = curl_easy_perform(curl);
-        fclose(fp); // Cerrar el archivo después de la descarga
-
-        if (res != CURLE_OK) {
-            show_message("Error al descargar " + backup_filename + ": " + std::string(curl_easy_strerror(res)));
-            fs::remove(temp_download_path); // Limpiar archivo parcial
-            all_restored_successfully = false;
-            continue;
-        }
-        show_message("Descarga de " + backup_filename + " completada. Descomprimiendo...");
-        if (decompress_file(temp_download_path, destination_folder)) {
-            show_message("Restauración de " + backup_filename + " exitosa en " + destination_folder_str);
-        } else {
-            show_message("Error al descomprimir " + backup_filename + ".");
-            all_restored_successfully = false;
-        }
-
-        // Limpiar el archivo ZIP descargado temporalmente
-        try {
-            fs::remove(temp_download_path);
-        } catch (const std::exception& e) {
-            std::cerr << "Advertencia: No se pudo eliminar el archivo temporal de descarga: " << e.what() << std::endl;
+    std::vector<std::string> errors = restore_backups(flask_api_base_url, selected_backups, destination_folder);
+    bool all_restored_successfully = errors.empty();
+    if (!all_restored_successfully) {
+        // Un solo diálogo con todos los errores en lugar de uno por respaldo.
+        std::string message;
+        for (const auto& error : errors) {
+            message += (message.empty() ? "" : "\n") + error;
         }
+        show_message(message);
     }
 
-    curl_easy_cleanup(curl);
-    curl_global_cleanup();
-
     if (all_restored_successfully) {
         show_message("Proceso de restauración completado exitosamente.");
     } else {
@@ -0,0 +1,282 @@
+#include "Codec.h"
+#include <zlib.h>
+#include <algorithm>
+#include <iostream>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
+// Tamaño del buffer de salida de los descompresores.
+static constexpr size_t DECODE_BUFFER_SIZE = 256 * 1024;
+
+uint16_t codec_method(CodecType type) {
+    switch (type) {
+        case CodecType::Store: return ZIP_METHOD_STORE;
+        case CodecType::Deflate: return ZIP_METHOD_DEFLATE;
+        case CodecType::Zstd: return ZIP_METHOD_ZSTD;
+        case CodecType::Lz4: return ZIP_METHOD_LZ4;
+    }
+    return ZIP_METHOD_STORE;
+}
+
+std::string codec_name(CodecType type) {
+    switch (type) {
+        case CodecType::Store: return "store";
+        case CodecType::Deflate: return "deflate";
+        case CodecType::Zstd: return "zstd";
+        case CodecType::Lz4: return "lz4";
+    }
+    return "store";
+}
+
+bool codec_from_name(const std::string& name, CodecType& type) {
+    for (CodecType t : {CodecType::Store, CodecType::Deflate, CodecType::Zstd, CodecType::Lz4}) {
+        if (codec_name(t) == name) {
+            type = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool codec_available(CodecType type) {
+    switch (type) {
+        case CodecType::Store:
+        case CodecType::Deflate:
+            return true;
+        case CodecType::Zstd:
+#ifdef HAVE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+        case CodecType::Lz4:
+#ifdef HAVE_LZ4
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+// --- Compresión ---
+
+// Stream deflate sin cabecera. Los bloques intermedios terminan con Z_SYNC_FLUSH para quedar
+// alineados a byte y poder concatenar el siguiente; el último termina con Z_FINISH.
+static bool deflate_block(const unsigned char* in, size_t len, const unsigned char* dict, size_t dict_len,
+                          int level, int flush, std::vector<unsigned char>& out) {
+    z_stream zs{};
+    if (deflateInit2(&zs, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    if (dict_len > 0) {
+        deflateSetDictionary(&zs, dict, dict_len);
+    }
+    out.resize(deflateBound(&zs, len) + 16);
+    zs.next_in = const_cast<unsigned char*>(in);
+    zs.avail_in = len;
+    zs.next_out = out.data();
+    zs.avail_out = out.size();
+    int ret = deflate(&zs, flush);
+    bool ok = flush == Z_FINISH ? ret == Z_STREAM_END : (ret == Z_OK && zs.avail_in == 0);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return ok;
+}
+
+#ifdef HAVE_ZSTD
+// Un contexto por hilo: crearlo para cada bloque sale caro en los niveles altos.
+static ZSTD_CCtx* thread_zstd_context() {
+    struct Holder {
+        ZSTD_CCtx* ctx = ZSTD_createCCtx();
+        ~Holder() { ZSTD_freeCCtx(ctx); }
+    };
+    thread_local Holder holder;
+    return holder.ctx;
+}
+#endif
+
+bool codec_compress(const CodecOptions& options, const unsigned char* in, size_t len,
+                    const unsigned char* dict, size_t dict_len, bool last, bool stored_fallback,
+                    std::vector<unsigned char>& out) {
+    switch (options.type) {
+        case CodecType::Store:
+            out.assign(in, in + len);
+            return true;
+
+        case CodecType::Deflate: {
+            int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+            int level = std::clamp(options.level, 1, 9);
+            if (!deflate_block(in, len, dict, dict_len, level, flush, out)) {
+                return false;
+            }
+            if (stored_fallback && out.size() >= len) {
+                // Datos que no se reducen: se emiten como bloques deflate "stored" (nivel 0),
+                // con solo unos bytes de sobrecarga.
+                return deflate_block(in, len, nullptr, 0, 0, flush, out);
+            }
+            return true;
+        }
+
+        case CodecType::Zstd: {
+#ifdef HAVE_ZSTD
+            // Cada bloque es un frame zstd independiente; los frames concatenados
+            // se descomprimen como un único stream.
+            ZSTD_CCtx* ctx = thread_zstd_context();
+            ZSTD_CCtx_reset(ctx, ZSTD_reset_session_and_parameters);
+            ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, std::clamp(options.level, 1, 19));
+            ZSTD_CCtx_setParameter(ctx, ZSTD_c_checksumFlag, 0); // El ZIP ya lleva CRC-32
+            out.resize(ZSTD_compressBound(len));
+            size_t n = ZSTD_compress2(ctx, out.data(), out.size(), in, len);
+            if (ZSTD_isError(n)) {
+                std::cerr << "Error de zstd: " << ZSTD_getErrorName(n) << std::endl;
+                return false;
+            }
+            out.resize(n);
+            return true;
+#else
+            break;
+#endif
+        }
+
+        case CodecType::Lz4: {
+#ifdef HAVE_LZ4
+            // Igual que zstd: un frame LZ4 por bloque.
+            LZ4F_preferences_t prefs{};
+            prefs.frameInfo.blockSizeID = LZ4F_max4MB;
+            prefs.frameInfo.contentSize = len;
+            out.resize(LZ4F_compressFrameBound(len, &prefs));
+            size_t n = LZ4F_compressFrame(out.data(), out.size(), in, len, &prefs);
+            if (LZ4F_isError(n)) {
+                std::cerr << "Error de lz4: " << LZ4F_getErrorName(n) << std::endl;
+                return false;
+            }
+            out.resize(n);
+            return true;
+#else
+            break;
+#endif
+        }
+    }
+    std::cerr << "Error: el codec " << codec_name(options.type) << " no está disponible." << std::endl;
+    return false;
+}
+
+// --- Descompresión ---
+
+class StoreDecoder : public Decoder {
+public:
+    bool feed(const unsigned char* in, size_t len, const DecodeSink& sink) override {
+        return len == 0 || sink(in, len);
+    }
+    bool finish() override { return true; }
+};
+
+class DeflateDecoder : public Decoder {
+public:
+    DeflateDecoder() : buffer(DECODE_BUFFER_SIZE) {
+        initialized = inflateInit2(&zs, -MAX_WBITS) == Z_OK;
+    }
+    ~DeflateDecoder() override {
+        if (initialized) inflateEnd(&zs);
+    }
+    bool feed(const unsigned char* in, size_t len, const DecodeSink& sink) override {
+        if (!initialized) return false;
+        zs.next_in = const_cast<unsigned char*>(in);
+        zs.avail_in = len;
+        while (zs.avail_in > 0 && !ended) {
+            zs.next_out = buffer.data();
+            zs.avail_out = buffer.size();
+            int ret = inflate(&zs, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END) return false;
+            size_t produced = buffer.size() - zs.avail_out;
+            if (produced > 0 && !sink(buffer.data(), produced)) return false;
+            ended = ret == Z_STREAM_END;
+        }
+        return true;
+    }
+    bool finish() override { return ended; }
+
+private:
+    z_stream zs{};
+    bool initialized = false;
+    bool ended = false;
+    std::vector<unsigned char> buffer;
+};
+
+#ifdef HAVE_ZSTD
+class ZstdDecoder : public Decoder {
+public:
+    ZstdDecoder() : stream(ZSTD_createDStream()), buffer(DECODE_BUFFER_SIZE) {}
+    ~ZstdDecoder() override { ZSTD_freeDStream(stream); }
+    bool feed(const unsigned char* in, size_t len, const DecodeSink& sink) override {
+        ZSTD_inBuffer input{in, len, 0};
+        while (input.pos < input.size) {
+            ZSTD_outBuffer output{buffer.data(), buffer.size(), 0};
+            last_result = ZSTD_decompressStream(stream, &output, &input);
+            if (ZSTD_isError(last_result)) return false;
+            if (output.pos > 0 && !sink(buffer.data(), output.pos)) return false;
+        }
+        return true;
+    }
+    // ZSTD_decompressStream devuelve 0 al completar un frame.
+    bool finish() override { return last_result == 0; }
+
+private:
+    ZSTD_DStream* stream;
+    size_t last_result = 0;
+    std::vector<unsigned char> buffer;
+};
+#endif
+
+#ifdef HAVE_LZ4
+class Lz4Decoder : public Decoder {
+public:
+    Lz4Decoder() : buffer(DECODE_BUFFER_SIZE) {
+        initialized = !LZ4F_isError(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION));
+    }
+    ~Lz4Decoder() override {
+        if (initialized) LZ4F_freeDecompressionContext(ctx);
+    }
+    bool feed(const unsigned char* in, size_t len, const DecodeSink& sink) override {
+        if (!initialized) return false;
+        size_t pos = 0;
+        while (pos < len) {
+            size_t out_size = buffer.size();
+            size_t in_size = len - pos;
+            last_hint = LZ4F_decompress(ctx, buffer.data(), &out_size, in + pos, &in_size, nullptr);
+            if (LZ4F_isError(last_hint)) return false;
+            pos += in_size;
+            if (out_size > 0 && !sink(buffer.data(), out_size)) return false;
+        }
+        return true;
+    }
+    // LZ4F_decompress devuelve 0 al completar un frame; el siguiente empieza solo.
+    bool finish() override { return last_hint == 0; }
+
+private:
+    LZ4F_dctx* ctx = nullptr;
+    bool initialized = false;
+    size_t last_hint = 0;
+    std::vector<unsigned char> buffer;
+};
+#endif
+
+std::unique_ptr<Decoder> make_decoder(uint16_t method) {
+    switch (method) {
+        case ZIP_METHOD_STORE: return std::make_unique<StoreDecoder>();
+        case ZIP_METHOD_DEFLATE: return std::make_unique<DeflateDecoder>();
+#ifdef HAVE_ZSTD
+        case ZIP_METHOD_ZSTD: return std::make_unique<ZstdDecoder>();
+#endif
+#ifdef HAVE_LZ4
+        case ZIP_METHOD_LZ4: return std::make_unique<Lz4Decoder>();
+#endif
+    }
+    return nullptr;
+}
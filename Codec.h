@@ -0,0 +1,56 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Algoritmos de compresión disponibles para un respaldo.
+enum class CodecType { Store, Deflate, Zstd, Lz4 };
+
+struct CodecOptions {
+    CodecType type = CodecType::Deflate;
+    int level = 6; // Deflate: 1-9, Zstd: 1-19. LZ4 no usa nivel.
+};
+
+// Métodos de compresión del formato ZIP. Zstd usa el identificador oficial (93);
+// LZ4 no tiene uno estándar, así que usamos uno propio que solo este programa entiende.
+constexpr uint16_t ZIP_METHOD_STORE = 0;
+constexpr uint16_t ZIP_METHOD_DEFLATE = 8;
+constexpr uint16_t ZIP_METHOD_ZSTD = 93;
+constexpr uint16_t ZIP_METHOD_LZ4 = 0x4C34;
+
+uint16_t codec_method(CodecType type);
+std::string codec_name(CodecType type);
+bool codec_from_name(const std::string& name, CodecType& type);
+// Indica si el programa se compiló con soporte para el codec (zstd y lz4 son opcionales).
+bool codec_available(CodecType type);
+
+// Comprime un bloque como parte de un stream. Los bloques de un mismo archivo se comprimen
+// por separado y se concatenan: 'last' indica si es el último del stream y 'dict' son los
+// bytes que preceden al bloque (solo deflate los aprovecha como diccionario).
+// Con 'stored_fallback', un bloque deflate que no se reduce se vuelve a emitir como bloques
+// "stored": hace falta en los bloques de un archivo partido, que no pueden guardarse sin
+// comprimir por separado. Quien guarda el archivo entero sin comprimir no necesita esa pasada.
+bool codec_compress(const CodecOptions& options, const unsigned char* in, size_t len,
+                    const unsigned char* dict, size_t dict_len, bool last, bool stored_fallback,
+                    std::vector<unsigned char>& out);
+
+// Descompresor por streaming: recibe los datos comprimidos por partes y entrega
+// los datos descomprimidos a 'sink' a medida que los produce.
+using DecodeSink = std::function<bool(const unsigned char* data, size_t len)>;
+
+class Decoder {
+public:
+    virtual ~Decoder() = default;
+    virtual bool feed(const unsigned char* in, size_t len, const DecodeSink& sink) = 0;
+    // Comprueba que el stream terminó correctamente.
+    virtual bool finish() = 0;
+};
+
+// Devuelve el descompresor para un método ZIP, o nullptr si no está soportado.
+std::unique_ptr<Decoder> make_decoder(uint16_t method);
+
+#endif // CODEC_H
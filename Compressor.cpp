@@ -0,0 +1,490 @@
+#include "Compressor.h"
+#include "ZipWriter.h"
+#include "Entropy.h"
+#include "IoEngine.h"
+#include "Pipeline.h"
+#include "Scheduler.h"
+#include <zlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <iomanip>
+
+// Los archivos mayores que SPLIT_THRESHOLD se cortan en bloques de BLOCK_SIZE que se comprimen
+// en paralelo. Con deflate cada bloque usa como diccionario los últimos 32 KB del bloque anterior
+// (como pigz) para no perder ratio en las fronteras.
+static constexpr uint64_t BLOCK_SIZE = 1ull << 20;
+static constexpr uint64_t SPLIT_THRESHOLD = 4 * BLOCK_SIZE;
+static constexpr uint64_t DICT_SIZE = 32768;
+// Mínimo de bytes comprimidos para estimar el tiempo ahorrado en los incompresibles.
+static constexpr uint64_t MIN_RATE_SAMPLE = BLOCK_SIZE;
+
+// Datos de cada archivo tomados una sola vez al planificar el respaldo.
+struct ItemInfo {
+    uint64_t size = 0;
+    uint32_t mode = 0;
+    time_t mtime = 0;
+    // En los archivos divididos se decide al planificar si se comprimen; los demás
+    // se deciden al leerlos, con la muestra que ya está en memoria.
+    bool compress = true;
+};
+
+// Unidad de trabajo: un archivo pequeño completo o un bloque de un archivo grande.
+struct WorkUnit {
+    size_t item;
+    uint64_t offset;
+    uint64_t length;
+    bool split;   // Pertenece a un archivo dividido en bloques
+    bool first;
+    bool last;
+};
+
+struct UnitResult {
+    bool ok = false;
+    uint16_t method = ZIP_METHOD_STORE;
+    uint32_t crc = 0;
+    uint64_t raw_size = 0;
+    bool skipped = false;  // Se guardó sin intentar comprimir
+    double cpu_seconds = 0;
+    std::vector<unsigned char> data;
+};
+
+// Grupo de unidades consecutivas que recorre el pipeline con uno de los buffers del pool.
+// SLAB_MAX_UNITS limita los archivos pequeños por grupo para que haya grupos para todos los
+// hilos de compresión.
+static constexpr size_t SLAB_MAX_UNITS = 64;
+
+struct Slab {
+    size_t seq = 0;
+    unsigned buffer = 0;
+    std::vector<WorkUnit> units;
+    std::vector<IoRead> reads; // Las de las unidades con archivo de origen, en orden
+    std::vector<UnitResult> results;
+};
+
+static double thread_cpu_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Lee hasta 'len' bytes desde 'offset'. Devuelve los bytes leídos o -1 si hubo error.
+static ssize_t read_range(int fd, uint64_t offset, unsigned char* buf, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pread(fd, buf + done, len - done, offset + done);
+        if (n < 0) return -1;
+        if (n == 0) break;
+        done += n;
+    }
+    return done;
+}
+
+// Bytes de diccionario que se leen antes de un bloque: el final del bloque anterior.
+static uint64_t dict_length(const WorkUnit& unit) {
+    return unit.split && !unit.first ? std::min(DICT_SIZE, unit.offset) : 0;
+}
+
+// Comprime una unidad ya leída por el IoEngine ('read' es nulo en las entradas en memoria).
+static void compress_unit(const ArchiveItem& item, const ItemInfo& info, const WorkUnit& unit,
+                          const CodecOptions& options, const IoRead* read, UnitResult& result) {
+    if (item.source.empty()) {
+        // Entrada generada en memoria: siempre es pequeña y va completa.
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(item.content.data());
+        result.ok = true;
+        result.raw_size = item.content.size();
+        result.crc = crc32(crc32(0L, Z_NULL, 0), data, item.content.size());
+        result.method = ZIP_METHOD_STORE;
+        result.data.assign(data, data + item.content.size());
+        return;
+    }
+
+    if (read->open_failed && !unit.split) {
+        std::cerr << "Error abriendo " << item.source << std::endl;
+        return;
+    }
+
+    // En los bloques se leyó también el final del bloque anterior para usarlo como diccionario.
+    uint64_t dict_len = dict_length(unit);
+    const unsigned char* raw = read->buffer;
+    size_t raw_size = read->length;
+    ssize_t n = read->result;
+    result.ok = true;
+    if (n != static_cast<ssize_t>(raw_size)) {
+        if (!unit.split && n < 0) {
+            std::cerr << "Error leyendo " << item.source << std::endl;
+            result.ok = false;
+            return;
+        }
+        if (unit.split) {
+            // Un bloque de una entrada ya empezada no puede descartarse: se escribe lo leído
+            // para que el ZIP siga siendo válido y se informa del error.
+            std::cerr << "Error: " << item.source << " cambió o no se pudo leer durante el respaldo." << std::endl;
+            result.ok = false;
+        }
+        raw_size = static_cast<size_t>(std::max<ssize_t>(n, 0));
+        dict_len = std::min<uint64_t>(dict_len, raw_size);
+    }
+
+    const unsigned char* data = raw + dict_len;
+    size_t len = raw_size - dict_len;
+    result.raw_size = len;
+    result.crc = crc32(crc32(0L, Z_NULL, 0), data, len);
+
+    bool compress = options.type != CodecType::Store &&
+                    (unit.split ? info.compress : worth_compressing(item.source, data, len));
+    if (!compress) {
+        result.method = ZIP_METHOD_STORE;
+        result.skipped = options.type != CodecType::Store;
+        result.data.assign(data, data + len);
+        return;
+    }
+
+    bool last = !unit.split || unit.last;
+    double cpu_start = thread_cpu_seconds();
+    bool compressed = codec_compress(options, data, len, raw, dict_len, last, unit.split, result.data);
+    result.cpu_seconds = thread_cpu_seconds() - cpu_start;
+    if (!compressed) {
+        std::cerr << "Error comprimiendo " << item.source << std::endl;
+        result.ok = false;
+        return;
+    }
+    result.method = codec_method(options.type);
+    if (!unit.split && result.method != ZIP_METHOD_STORE && result.data.size() >= len) {
+        // Archivo completo que no se reduce: se guarda sin comprimir.
+        result.method = ZIP_METHOD_STORE;
+        result.data.assign(data, data + len);
+    }
+}
+
+static ZipEntry make_entry(const ArchiveItem& item, const ItemInfo& info) {
+    ZipEntry entry;
+    entry.name = item.name;
+    entry.mode = info.mode;
+    to_dos_time(info.mtime, entry.dos_time, entry.dos_date);
+    return entry;
+}
+
+// Muestra del inicio de un archivo grande para decidir si se comprime.
+static bool sample_worth_compressing(const fs::path& path) {
+    if (has_compressed_extension(path)) {
+        return false;
+    }
+    unsigned char sample[ENTROPY_SAMPLE_SIZE];
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return true; // El error se informará al leer el archivo
+    bool drop = cache_policy() != CachePolicy::Normal;
+    if (drop) posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM); // Solo la muestra, sin leer por adelantado
+    ssize_t n = read_range(fd, 0, sample, sizeof(sample));
+    if (drop) drop_read_pages(fd, 0, sizeof(sample));
+    close(fd);
+    return n <= 0 || worth_compressing(path, sample, n);
+}
+
+std::string describe_stats(const BackupStats& stats) {
+    auto mb = [](uint64_t bytes) { return bytes / (1024.0 * 1024.0); };
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    out << "Comprimidos: " << stats.files_compressed << " archivos, "
+        << mb(stats.bytes_compressed_in) << " MB -> " << mb(stats.bytes_compressed_out) << " MB\n";
+    out << "Guardados sin comprimir: " << stats.files_stored << " archivos, " << mb(stats.bytes_stored) << " MB";
+    out << " (" << stats.files_skipped << " archivos, " << mb(stats.bytes_skipped)
+        << " MB detectados como incompresibles)\n";
+    out << std::setprecision(2) << "Tiempo de CPU comprimiendo: " << stats.compress_cpu_seconds << " s";
+    if (stats.bytes_attempted >= MIN_RATE_SAMPLE && stats.bytes_skipped > 0) {
+        // Estimación: lo que habría costado comprimir los bytes omitidos al ritmo medido.
+        // Con muy pocos bytes comprimidos el ritmo lo domina el coste fijo por archivo.
+        double saved = stats.compress_cpu_seconds * stats.bytes_skipped / stats.bytes_attempted;
+        out << " (ahorrados aprox. " << saved << " s)";
+    }
+    if (stats.scan_files > 0) {
+        out << "\nRecorrido: " << stats.scan_files << " archivos en " << stats.scan_directories << " carpetas, "
+            << stats.scan_syscalls << " llamadas al sistema ("
+            << static_cast<double>(stats.scan_syscalls) / stats.scan_files << " por archivo, statx "
+            << (stats.scan_uring ? "por io_uring" : "directos") << ")";
+        if (!stats.scan_order.empty()) {
+            out << "; orden de lectura " << stats.scan_order << ", ";
+            if (stats.scan_readers > 0) {
+                out << stats.scan_readers << " lecturas a la vez";
+            } else {
+                out << "lecturas en paralelo";
+            }
+        }
+    }
+    if (stats.pipeline_buffers > 0) {
+        out << std::setprecision(1) << "\nPipeline: " << stats.pipeline_buffers << " buffers de "
+            << mb(PIPELINE_BUFFER_SIZE) << " MB (presupuesto " << mb(stats.memory_budget)
+            << " MB); cola lectura -> compresión: máx. " << stats.read_queue.max_depth << " de "
+            << stats.read_queue.capacity << " (media " << stats.read_queue.average()
+            << "), compresión -> escritura: máx. " << stats.write_queue.max_depth << " (media "
+            << stats.write_queue.average() << "); la lectura esperó un buffer libre " << stats.buffer_waits
+            << " veces";
+    }
+    if (stats.cache.files > 0) {
+        out << "\n" << describe_cache_usage(stats.cache);
+    }
+    return out.str();
+}
+
+bool write_archive(const std::vector<ArchiveItem>& items, const ArchiveOutput& output,
+                   const CodecOptions& options, BackupStats* stats, std::vector<uint32_t>* crcs) {
+    bool all_ok = true;
+    BackupStats totals;
+
+    // Planificación: un stat por archivo (salvo que ya venga del recorrido). Las unidades de
+    // trabajo las va formando la etapa de lectura, así que no hay una lista de bloques.
+    std::vector<ItemInfo> infos(items.size());
+    std::vector<char> planned(items.size(), 0);
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (items[i].source.empty()) {
+            infos[i] = {items[i].content.size(), S_IFREG | 0644, std::time(nullptr)};
+        } else if (items[i].scanned) {
+            infos[i] = {items[i].size, items[i].mode, static_cast<time_t>(items[i].mtime_ns / 1000000000LL)};
+        } else {
+            struct stat st;
+            if (stat(items[i].source.c_str(), &st) != 0) {
+                std::cerr << "Error leyendo información de " << items[i].source << std::endl;
+                all_ok = false;
+                continue;
+            }
+            infos[i] = {static_cast<uint64_t>(st.st_size), static_cast<uint32_t>(st.st_mode), st.st_mtime};
+        }
+        planned[i] = 1;
+    }
+
+    ZipWriter writer;
+    if (output.sink ? !writer.open(output.sink) : !writer.open(output.path)) {
+        return false;
+    }
+
+    // Pipeline sobre el planificador: una tarea del carril Io lee grupos de unidades en los
+    // buffers del pool (registrados en el IoEngine), cada grupo leído se comprime en una tarea
+    // del carril Cpu y la escritura en orden la hacen tareas de prioridad alta del carril Io.
+    // Cada buffer vuelve al pool cuando su grupo ya está en el ZIP, así que los datos en vuelo
+    // (leídos y comprimidos) nunca pasan del presupuesto.
+    // Un respaldo pequeño no necesita todo el presupuesto: los buffers registrados se fijan en
+    // memoria aunque no se usen.
+    uint64_t budget = memory_budget();
+    uint64_t total_bytes = 0;
+    uint64_t total_files = 0;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (!planned[i] || items[i].source.empty()) continue;
+        total_bytes += infos[i].size;
+        total_files++;
+    }
+    uint64_t wanted = total_bytes / PIPELINE_BUFFER_SIZE + total_files / SLAB_MAX_UNITS + 2;
+    unsigned buffer_count = static_cast<unsigned>(std::min<uint64_t>(pipeline_buffer_count(budget), wanted));
+    IoEngine engine(PIPELINE_BUFFER_SIZE, buffer_count);
+    BufferPool pool(buffer_count);
+    MpmcQueue<Slab> read_queue(buffer_count);
+    MpmcQueue<Slab> write_queue(buffer_count);
+    std::atomic<bool> stop{false};
+
+    // Estado de la entrada dividida que el escritor está emitiendo.
+    uint32_t stream_crc = 0;
+    uint64_t stream_size = 0;
+    std::vector<uint32_t> item_crcs(items.size(), 0);
+    auto write_slab = [&](Slab& slab) {
+        for (size_t k = 0; k < slab.units.size(); ++k) {
+            const WorkUnit& unit = slab.units[k];
+            UnitResult& result = slab.results[k];
+            const ArchiveItem& item = items[unit.item];
+            if (!result.ok) {
+                all_ok = false; // Algún archivo no se pudo leer; el error ya se informó
+            }
+
+            if (unit.split ? unit.first : result.ok) {
+                bool stored = result.method == ZIP_METHOD_STORE;
+                (stored ? totals.files_stored : totals.files_compressed)++;
+                totals.files_skipped += result.skipped;
+            }
+            if (result.method == ZIP_METHOD_STORE) {
+                totals.bytes_stored += result.raw_size;
+                totals.bytes_skipped += result.skipped ? result.raw_size : 0;
+            } else {
+                totals.bytes_compressed_in += result.raw_size;
+                totals.bytes_compressed_out += result.data.size();
+            }
+            if (result.cpu_seconds > 0) {
+                totals.bytes_attempted += result.raw_size;
+                totals.compress_cpu_seconds += result.cpu_seconds;
+            }
+
+            if (!unit.split) {
+                if (!result.ok) continue;
+                ZipEntry entry = make_entry(item, infos[unit.item]);
+                entry.method = result.method;
+                entry.crc = result.crc;
+                entry.size = result.raw_size;
+                entry.data = std::move(result.data);
+                item_crcs[unit.item] = result.crc;
+                if (!writer.add(entry)) return false;
+                continue;
+            }
+
+            if (unit.first) {
+                ZipEntry meta = make_entry(item, infos[unit.item]);
+                meta.method = infos[unit.item].compress ? codec_method(options.type) : ZIP_METHOD_STORE;
+                // Margen por la sobrecarga de los bloques sin comprimir y de los frames.
+                uint64_t size = infos[unit.item].size;
+                bool zip64 = size + (size >> 10) + (1 << 16) >= 0xFFFFFFFFull;
+                if (!writer.begin_entry(meta, zip64)) return false;
+                stream_crc = crc32(0L, Z_NULL, 0);
+                stream_size = 0;
+            }
+            if (!writer.write_data(result.data.data(), result.data.size())) return false;
+            // Los CRC de los bloques se combinan sin volver a leer el archivo.
+            stream_crc = crc32_combine(stream_crc, result.crc, result.raw_size);
+            stream_size += result.raw_size;
+            if (unit.last) {
+                item_crcs[unit.item] = stream_crc;
+                if (!writer.end_entry(stream_crc, stream_size)) return false;
+            }
+        }
+        return true;
+    };
+
+    // Los grupos llegan desordenados; los que se adelantan esperan aquí con su buffer (nunca
+    // más que buffers hay en el pool). Cada grupo comprimido lanza una tarea de escritura: la
+    // que encuentra libre el escritor escribe todos los grupos que ya tocan, y las demás solo
+    // dejan su grupo en espera.
+    std::mutex order_mutex;
+    std::map<size_t, Slab> waiting;
+    size_t next_seq = 0;
+    bool writer_busy = false;
+    bool write_ok = true;
+    auto drain = [&] {
+        Slab slab;
+        write_queue.pop(slab);
+        std::unique_lock<std::mutex> lock(order_mutex);
+        waiting.emplace(slab.seq, std::move(slab));
+        if (writer_busy) return;
+        writer_busy = true;
+        for (auto it = waiting.find(next_seq); it != waiting.end(); it = waiting.find(++next_seq)) {
+            Slab ready = std::move(it->second);
+            waiting.erase(it);
+            lock.unlock();
+            if (write_ok && !write_slab(ready)) {
+                // Sin destino no tiene sentido seguir: se detiene la lectura y se vacía el pipeline.
+                write_ok = false;
+                stop = true;
+                pool.close();
+            }
+            pool.release(ready.buffer);
+            lock.lock();
+        }
+        writer_busy = false;
+    };
+
+    // Cada tarea de compresión toma un grupo entero; con muchos grupos en vuelo todos los
+    // hilos del carril Cpu trabajan, y cada unidad usa su propio stream.
+    // Los grupos se declaran en este orden para que, si algo falla, cada uno espere a sus
+    // tareas antes de destruirse el grupo al que estas lanzan trabajo.
+    TaskGroup writing(Lane::Io, Priority::High);
+    TaskGroup compressing(Lane::Cpu);
+    TaskGroup reading(Lane::Io);
+    auto compress_slab = [&] {
+        Slab slab;
+        read_queue.pop(slab);
+        slab.results.resize(slab.units.size());
+        size_t r = 0;
+        for (size_t k = 0; k < slab.units.size(); ++k) {
+            const WorkUnit& unit = slab.units[k];
+            const IoRead* read = items[unit.item].source.empty() ? nullptr : &slab.reads[r++];
+            compress_unit(items[unit.item], infos[unit.item], unit, options, read, slab.results[k]);
+        }
+        write_queue.push(std::move(slab));
+        writing.run(drain);
+    };
+
+    reading.run([&] {
+        size_t item = 0;
+        uint64_t offset = 0;
+        size_t seq = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            // Formar el grupo siguiente con las unidades que quepan en un buffer.
+            Slab slab;
+            uint64_t used = 0;
+            while (item < items.size() && slab.units.size() < SLAB_MAX_UNITS) {
+                if (!planned[item]) {
+                    ++item;
+                    continue;
+                }
+                const ItemInfo& info = infos[item];
+                bool split = !items[item].source.empty() && info.size > SPLIT_THRESHOLD;
+                uint64_t length = split ? std::min(BLOCK_SIZE, info.size - offset) : info.size;
+                WorkUnit unit{item, offset, length, split, offset == 0, offset + length == info.size};
+                uint64_t need = items[item].source.empty() ? 0 : direct_io_length(dict_length(unit) + length);
+                if (!slab.units.empty() && used + need > PIPELINE_BUFFER_SIZE) break;
+                if (split && unit.first && options.type != CodecType::Store) {
+                    infos[item].compress = sample_worth_compressing(items[item].source);
+                }
+                slab.units.push_back(unit);
+                used += need;
+                if (split && !unit.last) {
+                    offset += length;
+                } else {
+                    ++item;
+                    offset = 0;
+                }
+            }
+            if (slab.units.empty() || !pool.acquire(slab.buffer)) break;
+
+            // Cada lectura empieza alineada y con sitio para redondear su longitud, como pide O_DIRECT.
+            unsigned char* arena = engine.buffer(slab.buffer);
+            used = 0;
+            for (const WorkUnit& unit : slab.units) {
+                const ArchiveItem& source = items[unit.item];
+                if (source.source.empty()) continue;
+                IoRead read;
+                read.path = source.source.c_str();
+                read.offset = unit.offset - dict_length(unit);
+                read.length = dict_length(unit) + unit.length;
+                read.capacity = direct_io_length(read.length);
+                read.buffer = arena + used;
+                used += read.capacity;
+                slab.reads.push_back(read);
+            }
+            engine.read_all(slab.reads);
+            slab.seq = seq++;
+            read_queue.push(std::move(slab));
+            compressing.run(compress_slab);
+        }
+    });
+
+    // Cada grupo espera a que el anterior ya no pueda lanzarle tareas.
+    reading.wait();
+    compressing.wait();
+    writing.wait();
+    if (!write_ok) {
+        all_ok = false;
+    }
+
+    totals.memory_budget = budget;
+    totals.pipeline_buffers = buffer_count;
+    totals.read_queue = read_queue.statistics();
+    totals.write_queue = write_queue.statistics();
+    totals.buffer_waits = pool.waits();
+
+    // El codec queda registrado en los metadatos del ZIP; cada entrada lleva además su método.
+    std::string comment = "backup_tool codec=" + codec_name(options.type) + " level=" + std::to_string(options.level);
+    if (!all_ok) {
+        writer.discard(); // Un respaldo incompleto no reemplaza al anterior
+    } else if (!writer.close(comment)) {
+        all_ok = false;
+    }
+    if (stats) {
+        *stats = totals;
+    }
+    if (crcs) {
+        *crcs = std::move(item_crcs);
+    }
+    return all_ok;
+}
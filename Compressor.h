@@ -0,0 +1,83 @@
+#ifndef COMPRESSOR_H
+#define COMPRESSOR_H
+
+#include "Codec.h"
+#include "PageCache.h"
+#include "Pipeline.h"
+#include "ZipWriter.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Archivo de origen y el nombre que tendrá dentro del ZIP. Si 'source' está vacío la entrada
+// se crea con 'content' (metadatos generados por el programa, como la lista de borrados).
+// Si 'scanned' es true los datos del stat ya vienen del recorrido de las carpetas y no se
+// repite el stat al planificar el respaldo.
+struct ArchiveItem {
+    fs::path source;
+    std::string name;
+    std::string content;
+    bool scanned = false;
+    uint64_t size = 0;
+    uint32_t mode = 0;
+    int64_t mtime_ns = 0;
+    uint64_t inode = 0;
+};
+
+// Estadísticas de un respaldo para el informe final.
+struct BackupStats {
+    uint64_t files_compressed = 0;    // Entradas guardadas con el codec elegido
+    uint64_t bytes_compressed_in = 0;
+    uint64_t bytes_compressed_out = 0;
+    uint64_t files_stored = 0;        // Entradas guardadas sin comprimir
+    uint64_t bytes_stored = 0;
+    uint64_t files_skipped = 0;       // De las anteriores, las que ni se intentó comprimir
+    uint64_t bytes_skipped = 0;       // (extensión conocida o entropía alta)
+    uint64_t bytes_attempted = 0;     // Bytes que pasaron por el compresor
+    double compress_cpu_seconds = 0;  // Tiempo de CPU usado comprimiendo
+    // Recorrido de las carpetas (lo rellena compress_folders): llamadas al sistema hechas para
+    // listar y obtener los metadatos de los archivos.
+    uint64_t scan_files = 0;
+    uint64_t scan_directories = 0;
+    uint64_t scan_syscalls = 0;
+    bool scan_uring = false;
+    std::string scan_order;           // Orden de lectura (read_order_name) y lecturas a la vez
+    unsigned scan_readers = 0;        // (0: reparto ancho)
+    // Páginas de una muestra de los archivos leídos que quedaron en la caché (también lo rellena
+    // compress_folders; ver PageCache.h).
+    CacheUsage cache;
+    // Pipeline de la compresión (ver Pipeline.h): presupuesto, buffers del pool, ocupación de
+    // las colas lectura -> compresión -> escritura y veces que la lectura esperó un buffer libre.
+    uint64_t memory_budget = 0;
+    unsigned pipeline_buffers = 0;
+    QueueStats read_queue;
+    QueueStats write_queue;
+    uint64_t buffer_waits = 0;
+};
+
+// Resumen legible de las estadísticas, incluido el tiempo de CPU que se ahorró
+// al no comprimir los datos incompresibles.
+std::string describe_stats(const BackupStats& stats);
+
+// Destino del ZIP: un archivo o un ZipSink que recibe los bytes a medida que se escriben
+// (la subida a la nube en streaming, sin ZIP temporal).
+struct ArchiveOutput {
+    ArchiveOutput(const fs::path& path) : path(path) {}
+    ArchiveOutput(ZipSink sink) : sink(std::move(sink)) {}
+    fs::path path;
+    ZipSink sink;
+};
+
+// Crea el ZIP 'output' con todos los archivos de 'items'. Cada archivo (o bloque de un archivo grande)
+// se comprime en un hilo distinto con el codec elegido y un único escritor los añade al ZIP en orden.
+// Las etapas forman un pipeline acotado por memory_budget().
+// Los archivos que no se van a reducir (ver Entropy.h) se guardan sin comprimir.
+// Si 'crcs' no es nulo recibe el CRC-32 de cada elemento de 'items' (en el mismo orden).
+bool write_archive(const std::vector<ArchiveItem>& items, const ArchiveOutput& output,
+                   const CodecOptions& options = CodecOptions(), BackupStats* stats = nullptr,
+                   std::vector<uint32_t>* crcs = nullptr);
+
+#endif // COMPRESSOR_H
@@ -0,0 +1,76 @@
+#include "ConnectionPool.h"
+
+ConnectionPool& ConnectionPool::instance() {
+    static ConnectionPool pool;
+    return pool;
+}
+
+ConnectionPool::ConnectionPool() {
+    share = curl_share_init();
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlock);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+ConnectionPool::~ConnectionPool() {
+    close();
+}
+
+void ConnectionPool::lock(CURL*, curl_lock_data data, curl_lock_access, void* userp) {
+    static_cast<ConnectionPool*>(userp)->locks[data].lock();
+}
+
+void ConnectionPool::unlock(CURL*, curl_lock_data data, void* userp) {
+    static_cast<ConnectionPool*>(userp)->locks[data].unlock();
+}
+
+CURL* ConnectionPool::acquire() {
+    CURL* easy = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (!idle.empty()) {
+            easy = idle.back();
+            idle.pop_back();
+        }
+    }
+    if (easy) {
+        curl_easy_reset(easy);
+    } else {
+        easy = curl_easy_init();
+        if (!easy) return nullptr;
+    }
+    if (share) {
+        curl_easy_setopt(easy, CURLOPT_SHARE, share);
+    }
+    // Sin señales: los handles se usan desde varios hilos.
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    return easy;
+}
+
+void ConnectionPool::release(CURL* easy) {
+    if (!easy) return;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (share && idle.size() < POOL_MAX_IDLE) {
+            idle.push_back(easy);
+            return;
+        }
+    }
+    curl_easy_cleanup(easy);
+}
+
+void ConnectionPool::close() {
+    std::lock_guard<std::mutex> guard(mutex);
+    for (CURL* easy : idle) {
+        curl_easy_cleanup(easy);
+    }
+    idle.clear();
+    if (share) {
+        curl_share_cleanup(share);
+        share = nullptr;
+    }
+}
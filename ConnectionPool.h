@@ -0,0 +1,68 @@
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include <curl/curl.h>
+
+// Handles libres que se guardan para reutilizar; los que sobran se cierran.
+constexpr size_t POOL_MAX_IDLE = 16;
+
+// Gestor de conexiones HTTP de todo el proceso. Es dueño de un CURLSH que comparte la caché
+// de conexiones, el DNS y las sesiones TLS, y de un pool de easy handles que se reutilizan.
+// Todas las peticiones a la API (listado, subida, partes, descargas) salen de aquí, así que
+// una petición nueva encuentra abierta la conexión keep-alive de la anterior.
+class ConnectionPool {
+public:
+    static ConnectionPool& instance();
+
+    // Handle listo para configurar: sin opciones de una petición anterior pero asociado al
+    // CURLSH. Debe devolverse con release() (fuera de cualquier curl multi).
+    CURL* acquire();
+    void release(CURL* easy);
+    // Cierra los handles libres y las conexiones. Se llama antes de curl_global_cleanup.
+    void close();
+
+private:
+    ConnectionPool();
+    ~ConnectionPool();
+
+    static void lock(CURL*, curl_lock_data data, curl_lock_access, void* userp);
+    static void unlock(CURL*, curl_lock_data data, void* userp);
+
+    std::mutex mutex;
+    std::mutex locks[CURL_LOCK_DATA_LAST]; // cURL pide un mutex por tipo de dato compartido
+    CURLSH* share = nullptr;
+    std::vector<CURL*> idle;
+};
+
+// Handle del pool para una petición suelta; se devuelve al salir del ámbito.
+class PooledCurl {
+public:
+    PooledCurl() : easy(ConnectionPool::instance().acquire()) {}
+    ~PooledCurl() { ConnectionPool::instance().release(easy); }
+    PooledCurl(const PooledCurl&) = delete;
+    PooledCurl& operator=(const PooledCurl&) = delete;
+
+    CURL* get() const { return easy; }
+    explicit operator bool() const { return easy != nullptr; }
+
+private:
+    CURL* easy;
+};
+
+// Inicializa cURL para todo el proceso (al principio de main) y, al destruirse, cierra el
+// pool antes de curl_global_cleanup.
+class CurlGlobal {
+public:
+    CurlGlobal() { curl_global_init(CURL_GLOBAL_ALL); }
+    ~CurlGlobal() {
+        ConnectionPool::instance().close();
+        curl_global_cleanup();
+    }
+    CurlGlobal(const CurlGlobal&) = delete;
+    CurlGlobal& operator=(const CurlGlobal&) = delete;
+};
+
+#endif // CONNECTION_POOL_H
@@ -0,0 +1,318 @@
+#include "CopyEngine.h"
+#include "DirectoryScanner.h"
+#include "PageCache.h"
+#include "Scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <linux/fs.h> // FICLONE
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+// Buffer de la copia con read/write y tope de cada llamada a copy_file_range o sendfile.
+static constexpr size_t COPY_BUFFER_SIZE = 1 << 20;
+static constexpr size_t COPY_CHUNK_SIZE = 1 << 30;
+
+const char* copy_method_name(CopyMethod method) {
+    switch (method) {
+        case CopyMethod::Reflink: return "reflink";
+        case CopyMethod::CopyFileRange: return "copy_file_range";
+        case CopyMethod::Sendfile: return "sendfile";
+        case CopyMethod::ReadWrite: return "read/write";
+    }
+    return "?";
+}
+
+// Nombre del sistema de archivos de 'path' para el informe.
+static std::string filesystem_name(const fs::path& path) {
+    struct statfs st;
+    if (statfs(path.c_str(), &st) != 0) {
+        return "desconocido";
+    }
+    switch (static_cast<unsigned long>(st.f_type)) {
+        case 0x9123683EUL: return "btrfs";
+        case 0x58465342UL: return "xfs";
+        case 0xEF53UL: return "ext4";
+        case 0xF2F52010UL: return "f2fs";
+        case 0x2FC12FC1UL: return "zfs";
+        case 0x01021994UL: return "tmpfs";
+        case 0x794C7630UL: return "overlayfs";
+        case 0x6969UL: return "nfs";
+        case 0xFF534D42UL:
+        case 0xFE534D42UL: return "smb";
+        case 0x4D44UL: return "vfat";
+        case 0x2011BAB0UL: return "exfat";
+        case 0x65735546UL: return "fuse";
+    }
+    std::ostringstream out;
+    out << "0x" << std::hex << static_cast<unsigned long>(st.f_type);
+    return out.str();
+}
+
+namespace {
+
+enum class Step { Done, Unsupported, Failed };
+
+// Errores con los que un método no sirve para este par de archivos (pero el siguiente sí).
+bool unsupported(int err) {
+    return err == EOPNOTSUPP || err == ENOTTY || err == EXDEV || err == EINVAL || err == ENOSYS ||
+           err == EBADF || err == ETXTBSY;
+}
+
+// Con CachePolicy::DropBehind (o Direct: las copias del kernel no admiten O_DIRECT) la copia
+// avanza por ventanas de CACHE_WINDOW_SIZE: se pide por adelantado la siguiente ventana del
+// origen y se sueltan de la caché las páginas ya leídas y las ya escritas en el destino.
+class CacheWindow {
+public:
+    CacheWindow(int in, int out) : in(in), out(out), drop(cache_policy() != CachePolicy::Normal) {
+        if (drop) advise_sequential(in, 0, 2 * CACHE_WINDOW_SIZE);
+    }
+    size_t chunk() const { return drop ? CACHE_WINDOW_SIZE : COPY_CHUNK_SIZE; }
+
+    // Bytes copiados hasta 'done'.
+    void progress(uint64_t done) {
+        if (drop && done - start >= CACHE_WINDOW_SIZE) release(done);
+    }
+    void finish(uint64_t done) {
+        if (!drop) return;
+        if (done > start) release(done);
+        out.finish();
+    }
+
+private:
+    void release(uint64_t done) {
+        drop_read_pages(in, start, done - start);
+        out.written(start, done - start);
+        posix_fadvise(in, static_cast<off_t>(done + CACHE_WINDOW_SIZE), CACHE_WINDOW_SIZE, POSIX_FADV_WILLNEED);
+        start = done;
+    }
+
+    int in;
+    WriteBehind out;
+    bool drop;
+    uint64_t start = 0;
+};
+
+// Cada método copia desde 'done' hasta el final del origen; si no sirve, el siguiente sigue
+// desde donde quedó. copy_file_range y sendfile devuelven 0 antes de 'size' en algunos
+// sistemas de archivos (procfs, sysfs, algunos FUSE) que no los admiten: eso no es el final.
+Step copy_file_range_loop(int in, int out, uint64_t size, uint64_t& done, CacheWindow& window) {
+    for (;;) {
+        loff_t off_in = static_cast<loff_t>(done);
+        loff_t off_out = static_cast<loff_t>(done);
+        ssize_t n = copy_file_range(in, &off_in, out, &off_out, window.chunk(), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return unsupported(errno) ? Step::Unsupported : Step::Failed;
+        }
+        if (n == 0) return done < size ? Step::Unsupported : Step::Done;
+        done += static_cast<uint64_t>(n);
+        window.progress(done);
+    }
+}
+
+Step sendfile_loop(int in, int out, uint64_t size, uint64_t& done, CacheWindow& window) {
+    if (lseek(out, static_cast<off_t>(done), SEEK_SET) < 0) {
+        return Step::Failed;
+    }
+    for (;;) {
+        off_t offset = static_cast<off_t>(done);
+        ssize_t n = sendfile(out, in, &offset, window.chunk());
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return unsupported(errno) ? Step::Unsupported : Step::Failed;
+        }
+        if (n == 0) return done < size ? Step::Unsupported : Step::Done;
+        done += static_cast<uint64_t>(n);
+        window.progress(done);
+    }
+}
+
+Step read_write_loop(int in, int out, uint64_t& done, CacheWindow& window) {
+    std::vector<char> buffer(COPY_BUFFER_SIZE);
+    for (;;) {
+        ssize_t n = pread(in, buffer.data(), buffer.size(), static_cast<off_t>(done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return Step::Failed;
+        }
+        if (n == 0) return Step::Done;
+        ssize_t written = 0;
+        while (written < n) {
+            ssize_t w = pwrite(out, buffer.data() + written, n - written, static_cast<off_t>(done + written));
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                return Step::Failed;
+            }
+            written += w;
+        }
+        done += static_cast<uint64_t>(n);
+        window.progress(done);
+    }
+}
+
+struct CopyResult {
+    bool ok = false;
+    CopyMethod method = CopyMethod::ReadWrite;
+    uint64_t bytes = 0;
+};
+
+// Copia un archivo probando los métodos desde 'first'. Si un método no está soportado para
+// este par de sistemas de archivos, 'first' avanza para que los demás archivos no lo prueben.
+CopyResult copy_one(const FileRecord& file, const fs::path& target, std::atomic<int>& first) {
+    CopyResult result;
+    int in = open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        std::cerr << "Error abriendo " << file.path << ": " << std::strerror(errno) << std::endl;
+        return result;
+    }
+    int out = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, file.mode & 07777);
+    if (out < 0) {
+        std::cerr << "Error creando " << target << ": " << std::strerror(errno) << std::endl;
+        close(in);
+        return result;
+    }
+
+    uint64_t done = 0;
+    Step step = Step::Unsupported;
+    CacheWindow window(in, out);
+    for (int m = first.load(std::memory_order_relaxed); m < static_cast<int>(COPY_METHOD_COUNT); ++m) {
+        CopyMethod method = static_cast<CopyMethod>(m);
+        switch (method) {
+            case CopyMethod::Reflink:
+                step = ioctl(out, FICLONE, in) == 0 ? Step::Done : Step::Unsupported;
+                if (step == Step::Done) {
+                    struct stat st;
+                    done = fstat(out, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+                }
+                break;
+            case CopyMethod::CopyFileRange: step = copy_file_range_loop(in, out, file.size, done, window); break;
+            case CopyMethod::Sendfile: step = sendfile_loop(in, out, file.size, done, window); break;
+            case CopyMethod::ReadWrite: step = read_write_loop(in, out, done, window); break;
+        }
+        if (step != Step::Unsupported) {
+            result.method = method;
+            break;
+        }
+        // Solo se descarta el método si no copió nada: un fallo a mitad de archivo no dice
+        // que el sistema de archivos no lo admita.
+        if (done == 0) {
+            int expected = m;
+            first.compare_exchange_strong(expected, m + 1);
+        }
+    }
+    int err = errno;
+    if (step == Step::Done && result.method != CopyMethod::Reflink) {
+        window.finish(done); // Un reflink no pasa por la caché
+    }
+    if (step == Step::Done && fchmod(out, file.mode & 07777) != 0) {
+        err = errno;
+        step = Step::Failed;
+    }
+    if (close(out) != 0 && step == Step::Done) {
+        err = errno;
+        step = Step::Failed;
+    }
+    close(in);
+    if (step != Step::Done) {
+        std::cerr << "Error copiando " << file.path << ": " << std::strerror(err) << std::endl;
+        return result;
+    }
+    result.ok = true;
+    result.bytes = done;
+    return result;
+}
+
+} // namespace
+
+bool copy_tree(const fs::path& source, const fs::path& destination, CopyReport& report) {
+    std::vector<FileRecord> entries;
+    try {
+        entries = scan_tree(source, nullptr, true);
+        fs::create_directories(destination);
+    } catch (const std::exception& e) {
+        std::cerr << "Error preparando la copia de " << source << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    // Los directorios van primero y en orden (cada uno antes que su contenido), con los
+    // permisos del original.
+    bool all_ok = true;
+    std::vector<FileRecord> files;
+    for (FileRecord& entry : entries) {
+        if (!S_ISDIR(entry.mode)) {
+            files.push_back(std::move(entry));
+            continue;
+        }
+        std::error_code ec;
+        fs::path target = destination / entry.relative;
+        fs::create_directory(target, entry.path, ec);
+        if (ec) {
+            std::cerr << "Error creando directorio " << target << ": " << ec.message() << std::endl;
+            all_ok = false;
+        }
+    }
+
+    // Los archivos, en el orden y con las copias a la vez que convienen al disco de origen.
+    ReadSchedule schedule = choose_read_schedule(source);
+    sort_for_reading(files, schedule.order);
+
+    CacheSampler sampler;
+    for (size_t i = 0; i < files.size(); ++i) {
+        sampler.before_read(files[i].path, i);
+    }
+
+    std::vector<CopyResult> results(files.size());
+    std::atomic<int> first{static_cast<int>(CopyMethod::Reflink)};
+    parallel_for_width(Lane::Io, files.size(), schedule.readers, [&](size_t i) {
+        results[i] = copy_one(files[i], destination / files[i].relative, first);
+    });
+
+    CopyReport::Counts& counts = report.by_filesystem[filesystem_name(source) + " -> " + filesystem_name(destination)];
+    for (const CopyResult& result : results) {
+        if (!result.ok) {
+            report.failed++;
+            all_ok = false;
+            continue;
+        }
+        size_t m = static_cast<size_t>(result.method);
+        counts.files[m]++;
+        counts.bytes[m] += result.bytes;
+    }
+    sampler.finish(report.cache);
+    return all_ok;
+}
+
+std::string describe_copy_report(const CopyReport& report) {
+    std::ostringstream out;
+    out << std::fixed;
+    out.precision(1);
+    for (const auto& [filesystems, counts] : report.by_filesystem) {
+        out << filesystems << ":";
+        bool any = false;
+        for (size_t m = 0; m < COPY_METHOD_COUNT; ++m) {
+            if (counts.files[m] == 0) continue;
+            out << (any ? "," : "") << " " << counts.files[m] << " archivos por "
+                << copy_method_name(static_cast<CopyMethod>(m)) << " (" << counts.bytes[m] / (1024.0 * 1024.0)
+                << " MB)";
+            any = true;
+        }
+        if (!any) out << " sin archivos";
+        out << "\n";
+    }
+    if (report.failed > 0) {
+        out << "No se pudieron copiar " << report.failed << " archivos\n";
+    }
+    if (report.cache.files > 0) {
+        out << describe_cache_usage(report.cache) << "\n";
+    }
+    return out.str();
+}
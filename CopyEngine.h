@@ -0,0 +1,43 @@
+#ifndef COPY_ENGINE_H
+#define COPY_ENGINE_H
+
+#include "PageCache.h"
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Formas de copiar un archivo, de la más barata a la más cara. Se prueban en este orden y se
+// pasa a la siguiente cuando el sistema de archivos no admite la anterior.
+enum class CopyMethod {
+    Reflink,       // ioctl FICLONE: comparte los bloques (btrfs, XFS), sin copiar datos
+    CopyFileRange, // copy_file_range: la copia la hace el kernel (o el servidor NFS/SMB)
+    Sendfile,      // sendfile: sin pasar por memoria del proceso
+    ReadWrite      // read/write con un buffer grande
+};
+constexpr size_t COPY_METHOD_COUNT = 4;
+const char* copy_method_name(CopyMethod method);
+
+// Archivos y bytes copiados con cada método, por par de sistemas de archivos
+// ("ext4 -> vfat"), y los archivos que no se pudieron copiar.
+struct CopyReport {
+    struct Counts {
+        std::array<uint64_t, COPY_METHOD_COUNT> files{};
+        std::array<uint64_t, COPY_METHOD_COUNT> bytes{};
+    };
+    std::map<std::string, Counts> by_filesystem;
+    uint64_t failed = 0;
+    CacheUsage cache; // Muestra de la caché de páginas de los archivos de origen
+};
+std::string describe_copy_report(const CopyReport& report);
+
+// Copia el contenido de 'source' en 'destination' (creando los directorios y sobrescribiendo
+// los archivos que ya existan). El árbol se lista con scan_tree y los archivos se copian en
+// paralelo, o de pocos en pocos y en orden físico si el origen está en un disco rotacional
+// (choose_read_schedule). Devuelve false si falló algún archivo o directorio; 'report' acumula lo copiado.
+bool copy_tree(const fs::path& source, const fs::path& destination, CopyReport& report);
+
+#endif // COPY_ENGINE_H
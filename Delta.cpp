@@ -0,0 +1,474 @@
+#include "Delta.h"
+#include "PageCache.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <openssl/sha.h>
+#include <zlib.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+static const char SIGNATURE_MAGIC[4] = {'B', 'T', 'S', 'G'};
+static const char DELTA_MAGIC[4] = {'B', 'T', 'D', 'L'};
+static constexpr uint32_t DELTA_FORMAT_VERSION = 1;
+
+// Los literales se escriben en trozos de como mucho 1 MB para que la restauración
+// no necesite buffers grandes.
+static constexpr size_t MAX_LITERAL_SIZE = 1024 * 1024;
+
+struct SignatureHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t crc;
+    uint64_t file_size;
+    uint64_t count;
+};
+
+struct DeltaHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t new_crc;
+    uint64_t base_size;
+    uint64_t new_size;
+};
+
+static_assert(sizeof(SignatureHeader) == 32, "cabecera de la firma");
+static_assert(sizeof(DeltaHeader) == 32, "cabecera del delta");
+
+// Operaciones del delta: COPY <bloque u64> <cantidad u32>, LITERAL <largo u32> <datos>, END.
+enum DeltaOp : uint8_t { DELTA_OP_END = 0, DELTA_OP_COPY = 1, DELTA_OP_LITERAL = 2 };
+
+// Lector secuencial con pread. Con mmap, un archivo que otro proceso acorta mientras se recorre
+// termina en SIGBUS; aquí es una lectura corta y el cálculo se cancela. Salvo con
+// CachePolicy::Normal, cada trozo leído se suelta de la caché (las firmas leen archivos grandes enteros).
+class FileReader {
+public:
+    ~FileReader() {
+        if (fd >= 0) close(fd);
+    }
+    bool open(const fs::path& path) {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) return false;
+        size = st.st_size;
+        advise_sequential(fd, 0, CACHE_WINDOW_SIZE);
+        return true;
+    }
+    // Lee en 'buf' los siguientes min(len, lo que falta) bytes; false si el archivo se acortó
+    // o la lectura falló.
+    bool read(unsigned char* buf, size_t len, size_t& got) {
+        got = static_cast<size_t>(std::min<uint64_t>(len, size - offset));
+        size_t done = 0;
+        while (done < got) {
+            ssize_t n = pread(fd, buf + done, got - done, static_cast<off_t>(offset + done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            done += n;
+        }
+        if (cache_policy() != CachePolicy::Normal) drop_read_pages(fd, offset, got);
+        offset += got;
+        return true;
+    }
+    uint64_t size = 0;   // Tamaño al abrirlo: es el que se lee y el que queda en la firma
+    uint64_t offset = 0; // Bytes ya leídos
+
+private:
+    int fd = -1;
+};
+
+// Checksum débil de rsync: a = suma de los bytes, b = suma ponderada; ambas módulo 2^16.
+// Se puede desplazar un byte en O(1), así que se prueba en todas las posiciones.
+struct RollingChecksum {
+    uint32_t a = 0;
+    uint32_t b = 0;
+    uint32_t len = 0;
+
+    void reset(const unsigned char* data, uint32_t n) {
+        a = b = 0;
+        len = n;
+        for (uint32_t i = 0; i < n; ++i) {
+            a += data[i];
+            b += (n - i) * data[i];
+        }
+        a &= 0xffff;
+        b &= 0xffff;
+    }
+    void roll(unsigned char out, unsigned char in) {
+        a = (a - out + in) & 0xffff;
+        b = (b - len * out + a) & 0xffff;
+    }
+    uint32_t value() const { return a | (b << 16); }
+};
+
+static std::array<unsigned char, 16> strong_checksum(const unsigned char* data, size_t len) {
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(data, len, digest);
+    std::array<unsigned char, 16> result;
+    std::memcpy(result.data(), digest, result.size());
+    return result;
+}
+
+// CRC-32 de todo el archivo y, si 'signature' no es nulo, su firma, calculados sobre los trozos
+// a medida que se leen: cada bloque se lee una vez para el CRC y los dos checksums.
+class BlockScanner {
+public:
+    BlockScanner(uint64_t size, FileSignature* signature) : signature(signature) {
+        // Solo se indexan los bloques completos; el resto final, si lo hay, no se reutiliza.
+        if (signature) {
+            signature->block_size = DELTA_BLOCK_SIZE;
+            signature->file_size = size;
+            signature->weak.resize(size / DELTA_BLOCK_SIZE);
+            signature->strong.resize(size / DELTA_BLOCK_SIZE);
+        }
+    }
+    void feed(const unsigned char* data, size_t len) {
+        crc = crc32(crc, data, static_cast<uInt>(len));
+        if (!signature) return;
+        // Un bloque partido entre dos trozos se junta en 'partial'.
+        if (!partial.empty()) {
+            size_t take = std::min<size_t>(len, DELTA_BLOCK_SIZE - partial.size());
+            partial.insert(partial.end(), data, data + take);
+            data += take;
+            len -= take;
+            if (partial.size() < DELTA_BLOCK_SIZE) return;
+            block(partial.data());
+            partial.clear();
+        }
+        for (; len >= DELTA_BLOCK_SIZE; data += DELTA_BLOCK_SIZE, len -= DELTA_BLOCK_SIZE) {
+            block(data);
+        }
+        partial.assign(data, data + len);
+    }
+    uint32_t finish() {
+        if (signature) signature->crc = crc;
+        return crc;
+    }
+
+private:
+    void block(const unsigned char* data) {
+        RollingChecksum rolling;
+        rolling.reset(data, DELTA_BLOCK_SIZE);
+        signature->weak[blocks] = rolling.value();
+        signature->strong[blocks] = strong_checksum(data, DELTA_BLOCK_SIZE);
+        ++blocks;
+    }
+
+    FileSignature* signature;
+    uint32_t crc = crc32(0L, Z_NULL, 0);
+    std::vector<unsigned char> partial;
+    size_t blocks = 0;
+};
+
+bool compute_signature(const fs::path& path, FileSignature& signature) {
+    FileReader file;
+    if (!file.open(path)) {
+        std::cerr << "Error leyendo " << path << " para calcular su firma." << std::endl;
+        return false;
+    }
+    BlockScanner scanner(file.size, &signature);
+    std::vector<unsigned char> buffer(CACHE_WINDOW_SIZE);
+    while (file.offset < file.size) {
+        size_t got;
+        if (!file.read(buffer.data(), buffer.size(), got)) {
+            std::cerr << "Error: " << path << " cambió o no se pudo leer al calcular su firma." << std::endl;
+            return false;
+        }
+        scanner.feed(buffer.data(), got);
+    }
+    scanner.finish();
+    return true;
+}
+
+bool save_signature(const fs::path& path, const FileSignature& signature) {
+    SignatureHeader header{};
+    std::memcpy(header.magic, SIGNATURE_MAGIC, 4);
+    header.version = DELTA_FORMAT_VERSION;
+    header.block_size = signature.block_size;
+    header.crc = signature.crc;
+    header.file_size = signature.file_size;
+    header.count = signature.weak.size();
+
+    FILE* out = fopen(path.c_str(), "wb");
+    if (!out) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+              fwrite(signature.weak.data(), sizeof(uint32_t), header.count, out) == header.count &&
+              fwrite(signature.strong.data(), 16, header.count, out) == header.count;
+    ok = fclose(out) == 0 && ok;
+    return ok;
+}
+
+bool load_signature(const fs::path& path, FileSignature& signature) {
+    FILE* in = fopen(path.c_str(), "rb");
+    if (!in) return false;
+    SignatureHeader header;
+    bool ok = fread(&header, sizeof(header), 1, in) == 1 &&
+              std::memcmp(header.magic, SIGNATURE_MAGIC, 4) == 0 &&
+              header.version == DELTA_FORMAT_VERSION && header.block_size > 0 &&
+              header.count == header.file_size / header.block_size;
+    if (ok) {
+        signature.block_size = header.block_size;
+        signature.file_size = header.file_size;
+        signature.crc = header.crc;
+        signature.weak.resize(header.count);
+        signature.strong.resize(header.count);
+        ok = fread(signature.weak.data(), sizeof(uint32_t), header.count, in) == header.count &&
+             fread(signature.strong.data(), 16, header.count, in) == header.count;
+    }
+    fclose(in);
+    return ok;
+}
+
+// Escritor de las operaciones del delta. Junta copias de bloques consecutivos en una sola.
+class DeltaWriter {
+public:
+    explicit DeltaWriter(FILE* out) : out(out) {}
+
+    void copy(uint64_t block, uint64_t block_size) {
+        if (copy_count > 0 && block == copy_first + copy_count && copy_count < UINT32_MAX) {
+            ++copy_count;
+        } else {
+            flush_copy();
+            copy_first = block;
+            copy_count = 1;
+        }
+        result.copied_bytes += block_size;
+    }
+    void literal(const unsigned char* data, size_t len) {
+        flush_copy();
+        result.literal_bytes += len;
+        while (len > 0) {
+            uint32_t n = static_cast<uint32_t>(std::min(len, MAX_LITERAL_SIZE));
+            put(DELTA_OP_LITERAL);
+            put(n);
+            ok = ok && fwrite(data, 1, n, out) == n;
+            data += n;
+            len -= n;
+        }
+    }
+    void end() {
+        flush_copy();
+        put(DELTA_OP_END);
+    }
+
+    bool ok = true;
+    DeltaResult result;
+
+private:
+    template <typename T>
+    void put(T value) {
+        ok = ok && fwrite(&value, sizeof(value), 1, out) == 1;
+    }
+    void flush_copy() {
+        if (copy_count == 0) return;
+        put(DELTA_OP_COPY);
+        put(copy_first);
+        put(copy_count);
+        copy_count = 0;
+    }
+
+    FILE* out;
+    uint64_t copy_first = 0;
+    uint32_t copy_count = 0;
+};
+
+bool write_delta(const fs::path& path, const FileSignature& basis, const fs::path& delta_path,
+                 DeltaResult& result, FileSignature* signature) {
+    FileReader file;
+    if (!file.open(path)) {
+        std::cerr << "Error leyendo " << path << " para calcular el delta." << std::endl;
+        return false;
+    }
+    FILE* out = fopen(delta_path.c_str(), "wb");
+    if (!out) {
+        std::cerr << "Error creando el delta " << delta_path << std::endl;
+        return false;
+    }
+    std::vector<char> out_buffer(1024 * 1024);
+    setvbuf(out, out_buffer.data(), _IOFBF, out_buffer.size());
+
+    // El CRC de la versión nueva se conoce al terminar de leerla: la cabecera se reescribe al final.
+    DeltaHeader header{};
+    std::memcpy(header.magic, DELTA_MAGIC, 4);
+    header.version = DELTA_FORMAT_VERSION;
+    header.block_size = basis.block_size;
+    header.base_size = basis.file_size;
+    header.new_size = file.size;
+
+    // Índice de los checksums débiles de la versión anterior; las colisiones se encadenan.
+    std::unordered_map<uint32_t, uint32_t> first_block;
+    std::vector<uint32_t> next_block(basis.weak.size(), UINT32_MAX);
+    first_block.reserve(basis.weak.size());
+    for (size_t i = basis.weak.size(); i-- > 0;) {
+        auto [it, inserted] = first_block.emplace(basis.weak[i], static_cast<uint32_t>(i));
+        if (!inserted) {
+            next_block[i] = it->second;
+            it->second = static_cast<uint32_t>(i);
+        }
+    }
+
+    DeltaWriter writer(out);
+    writer.ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    const uint32_t block_size = basis.block_size;
+    const uint64_t size = file.size;
+    BlockScanner scanner(size, signature);
+    uint64_t pos = 0;
+    uint64_t literal_start = 0;
+    uint64_t expected_block = UINT64_MAX; // Bloque que seguiría a la última copia
+
+    // Ventana deslizante sobre el archivo: 'window' guarda los bytes [base, end). Al leer el
+    // siguiente trozo solo se conserva desde 'pos' (como mucho un bloque, lo que mira el checksum
+    // rodante); el literal pendiente anterior a 'pos' se escribe antes de descartarlo.
+    std::vector<unsigned char> window(CACHE_WINDOW_SIZE + block_size);
+    uint64_t base = 0;
+    uint64_t end = 0;
+    bool read_ok = true;
+    auto at = [&](uint64_t offset) { return window.data() + (offset - base); };
+    auto fill = [&](uint64_t limit) {
+        while (end < limit && end < size && read_ok) {
+            if (pos > literal_start) {
+                writer.literal(at(literal_start), pos - literal_start);
+                literal_start = pos;
+            }
+            size_t keep = end - pos;
+            std::memmove(window.data(), at(pos), keep);
+            base = pos;
+            size_t got;
+            read_ok = file.read(window.data() + keep, window.size() - keep, got);
+            if (read_ok) {
+                scanner.feed(window.data() + keep, got);
+                end += got;
+            }
+        }
+        return end >= limit;
+    };
+
+    RollingChecksum rolling;
+    if (size >= block_size && !first_block.empty() && fill(block_size)) {
+        rolling.reset(at(0), block_size);
+        while (writer.ok) {
+            auto it = first_block.find(rolling.value());
+            if (it != first_block.end()) {
+                // Coincide el débil: confirmar con el fuerte, prefiriendo el bloque que
+                // continúa la copia anterior (lo habitual en modificaciones en el sitio).
+                std::array<unsigned char, 16> strong = strong_checksum(at(pos), block_size);
+                uint64_t match = UINT64_MAX;
+                for (uint32_t b = it->second; b != UINT32_MAX; b = next_block[b]) {
+                    if (basis.strong[b] == strong) {
+                        match = b;
+                        if (b == expected_block) break;
+                    }
+                }
+                if (match != UINT64_MAX) {
+                    if (pos > literal_start) {
+                        writer.literal(at(literal_start), pos - literal_start);
+                    }
+                    writer.copy(match, block_size);
+                    expected_block = match + 1;
+                    pos += block_size;
+                    literal_start = pos;
+                    if (pos + block_size > size || !fill(pos + block_size)) break;
+                    rolling.reset(at(pos), block_size);
+                    continue;
+                }
+            }
+            if (pos + block_size >= size || !fill(pos + block_size + 1)) break;
+            rolling.roll(*at(pos), *at(pos + block_size));
+            ++pos;
+        }
+    }
+    // El resto del archivo va como literal, trozo a trozo.
+    while (read_ok && writer.ok) {
+        if (end > literal_start) {
+            writer.literal(at(literal_start), end - literal_start);
+            literal_start = end;
+        }
+        if (end >= size) break;
+        pos = end;
+        fill(end + 1);
+    }
+    writer.end();
+    header.new_crc = scanner.finish();
+    writer.ok = writer.ok && fseek(out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, out) == 1;
+
+    bool ok = writer.ok;
+    ok = fclose(out) == 0 && ok;
+    if (!read_ok || !ok) {
+        if (!read_ok) {
+            std::cerr << "Error: " << path << " cambió o no se pudo leer al calcular el delta." << std::endl;
+        } else {
+            std::cerr << "Error escribiendo el delta " << delta_path << std::endl;
+        }
+        std::error_code ec;
+        fs::remove(delta_path, ec);
+        return false;
+    }
+    result = writer.result;
+    result.crc = header.new_crc;
+    return true;
+}
+
+bool apply_delta(const fs::path& basis_path, const fs::path& delta_path, const fs::path& out_path) {
+    FILE* delta = fopen(delta_path.c_str(), "rb");
+    if (!delta) return false;
+    int basis = ::open(basis_path.c_str(), O_RDONLY);
+    FILE* out = fopen(out_path.c_str(), "wb");
+    std::vector<char> out_buffer(1024 * 1024);
+    if (out) setvbuf(out, out_buffer.data(), _IOFBF, out_buffer.size());
+
+    DeltaHeader header{};
+    struct stat st;
+    bool ok = basis >= 0 && out && fread(&header, sizeof(header), 1, delta) == 1 &&
+              std::memcmp(header.magic, DELTA_MAGIC, 4) == 0 && header.version == DELTA_FORMAT_VERSION &&
+              header.block_size > 0 && fstat(basis, &st) == 0 &&
+              static_cast<uint64_t>(st.st_size) == header.base_size;
+    if (!ok) {
+        std::cerr << "La versión anterior de " << basis_path
+                  << " no coincide con la del delta (¿se restauró el respaldo anterior?)." << std::endl;
+    }
+
+    std::vector<unsigned char> buffer(std::max<size_t>(header.block_size, MAX_LITERAL_SIZE));
+    uint32_t crc = crc32(0L, Z_NULL, 0);
+    uint64_t written = 0;
+    auto emit = [&](const unsigned char* data, size_t len) {
+        crc = crc32(crc, data, len);
+        written += len;
+        return fwrite(data, 1, len, out) == len;
+    };
+    while (ok) {
+        uint8_t op;
+        if (fread(&op, 1, 1, delta) != 1) {
+            ok = false;
+        } else if (op == DELTA_OP_END) {
+            break;
+        } else if (op == DELTA_OP_COPY) {
+            uint64_t first;
+            uint32_t count;
+            ok = fread(&first, sizeof(first), 1, delta) == 1 && fread(&count, sizeof(count), 1, delta) == 1 &&
+                 (first + count) * header.block_size <= header.base_size;
+            for (uint32_t i = 0; ok && i < count; ++i) {
+                off_t offset = static_cast<off_t>((first + i) * header.block_size);
+                ok = pread(basis, buffer.data(), header.block_size, offset) == static_cast<ssize_t>(header.block_size) &&
+                     emit(buffer.data(), header.block_size);
+            }
+        } else if (op == DELTA_OP_LITERAL) {
+            uint32_t len;
+            ok = fread(&len, sizeof(len), 1, delta) == 1 && len <= MAX_LITERAL_SIZE &&
+                 fread(buffer.data(), 1, len, delta) == len && emit(buffer.data(), len);
+        } else {
+            ok = false;
+        }
+    }
+    ok = ok && written == header.new_size && crc == header.new_crc;
+
+    fclose(delta);
+    if (basis >= 0) close(basis);
+    if (out) ok = fclose(out) == 0 && ok;
+    return ok;
+}
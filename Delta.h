@@ -0,0 +1,51 @@
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Delta por bloques al estilo rsync para archivos grandes que cambian poco (bases de datos,
+// buzones de correo, discos de máquinas virtuales). Del respaldo anterior se guarda una firma
+// con un checksum débil rodante y uno fuerte por bloque; el delta solo lleva los rangos que
+// no aparecen en la versión anterior.
+
+// Solo se calculan firmas y deltas para archivos de al menos este tamaño.
+constexpr uint64_t DELTA_MIN_FILE_SIZE = 16 * 1024 * 1024;
+constexpr uint32_t DELTA_BLOCK_SIZE = 64 * 1024;
+
+// Firma de una versión de un archivo.
+struct FileSignature {
+    uint32_t block_size = DELTA_BLOCK_SIZE;
+    uint64_t file_size = 0;
+    uint32_t crc = 0;                                // CRC-32 de todo el archivo
+    std::vector<uint32_t> weak;                      // Checksum rodante (rsync) de cada bloque
+    std::vector<std::array<unsigned char, 16>> strong; // SHA-256 truncado de cada bloque
+};
+
+bool compute_signature(const fs::path& path, FileSignature& signature);
+bool save_signature(const fs::path& path, const FileSignature& signature);
+bool load_signature(const fs::path& path, FileSignature& signature);
+
+struct DeltaResult {
+    uint64_t copied_bytes = 0;  // Bytes que se toman de la versión anterior
+    uint64_t literal_bytes = 0; // Bytes nuevos que van dentro del delta
+    uint32_t crc = 0;           // CRC-32 de la versión nueva
+};
+
+// Escribe en 'delta_path' las instrucciones para reconstruir 'path' a partir de la versión
+// descrita por 'basis': copias de bloques de la versión anterior y datos literales. Si
+// 'signature' no es nulo recibe también la firma de la versión nueva, calculada en la misma
+// lectura del archivo en vez de leerlo otra vez con compute_signature. Falla si el archivo
+// se acorta mientras se lee.
+bool write_delta(const fs::path& path, const FileSignature& basis, const fs::path& delta_path,
+                 DeltaResult& result, FileSignature* signature = nullptr);
+
+// Reconstruye en 'out_path' la versión nueva a partir de la anterior ('basis_path') y el delta.
+// Comprueba el tamaño de la versión anterior y el CRC del resultado.
+bool apply_delta(const fs::path& basis_path, const fs::path& delta_path, const fs::path& out_path);
+
+#endif // DELTA_H
@@ -0,0 +1,345 @@
+#include "DirectoryScanner.h"
+#include "MetadataCollector.h"
+#include "Scheduler.h"
+#include "SystemLimits.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Bytes de entradas que se piden en cada getdents64 (glibc usa 32 KB en readdir).
+static constexpr size_t DIRENT_BUFFER_SIZE = 64 * 1024;
+
+namespace {
+
+// Formato de las entradas que devuelve getdents64.
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// Estado de cada hilo del carril Io: su etapa de metadatos (con su anillo) y sus contadores.
+struct ScanWorker {
+    MetadataCollector metadata;
+    std::vector<char> dirents = std::vector<char>(DIRENT_BUFFER_SIZE);
+    uint64_t syscalls = 0;
+    uint64_t files = 0;
+    uint64_t directories = 0;
+};
+
+// Entrada pendiente de statx dentro de un directorio.
+struct PendingEntry {
+    std::string name;
+    unsigned char type;
+};
+
+// Estado compartido por las tareas de un recorrido. El primer error detiene el resto.
+class TreeScan {
+public:
+    TreeScan(const ScanSink& sink, bool with_directories)
+        : sink(sink), with_directories(with_directories), workers(scheduler_threads(Lane::Io)) {}
+
+    bool run(const fs::path& root, std::error_code& ec, fs::path& where, ScanStats* stats) {
+        group.run([this, root] { scan(root, std::string(), true); });
+        group.wait();
+        if (stats) {
+            *stats = ScanStats();
+            for (const std::unique_ptr<ScanWorker>& worker : workers) {
+                if (!worker) continue;
+                stats->files += worker->files;
+                stats->directories += worker->directories;
+                stats->syscalls += worker->syscalls + worker->metadata.syscalls();
+                stats->uring = stats->uring || worker->metadata.uses_uring();
+            }
+        }
+        if (failed) {
+            ec = error;
+            where = error_path;
+        }
+        return !failed;
+    }
+
+private:
+    void fail(int err, const fs::path& path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!failed) {
+            error = std::error_code(err, std::generic_category());
+            error_path = path;
+            failed = true;
+        }
+    }
+
+    // Encola un subdirectorio y, si se pidieron, lo anota en 'directories'.
+    void spawn(const fs::path& dir, const std::string& relative, std::vector<FileRecord>& directories) {
+        if (with_directories) {
+            FileRecord record;
+            record.path = dir;
+            record.relative = relative;
+            record.mode = S_IFDIR;
+            directories.push_back(std::move(record));
+        }
+        group.run([this, dir, relative] { scan(dir, relative, false); });
+    }
+
+    // Lee un directorio: encola sus subdirectorios como tareas nuevas y pasa sus archivos por
+    // la etapa de metadatos en lotes.
+    void scan(const fs::path& dir, const std::string& relative, bool is_root) {
+        if (failed) return;
+        // Las tareas solo corren en los hilos del carril, y una no empieza otra en su hilo.
+        std::unique_ptr<ScanWorker>& slot = workers[current_worker(Lane::Io)];
+        if (!slot) slot = std::make_unique<ScanWorker>();
+        ScanWorker& worker = *slot;
+        worker.syscalls++;
+        int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            // Un subdirectorio borrado mientras se recorre no es un error.
+            if (is_root || errno != ENOENT) fail(errno, dir);
+            return;
+        }
+        worker.directories++;
+
+        std::vector<PendingEntry> pending;
+        std::vector<FileRecord> directories;
+        for (;;) {
+            worker.syscalls++;
+            long n = syscall(SYS_getdents64, fd, worker.dirents.data(), worker.dirents.size());
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                fail(errno, dir);
+                break;
+            }
+            if (n == 0) break;
+            for (long pos = 0; pos < n;) {
+                const LinuxDirent64* entry = reinterpret_cast<const LinuxDirent64*>(worker.dirents.data() + pos);
+                pos += entry->d_reclen;
+                const char* name = entry->d_name;
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                    continue;
+                }
+                if (entry->d_type == DT_DIR) {
+                    spawn(dir / name, child_name(relative, name), directories);
+                } else if (entry->d_type == DT_REG || entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+                    pending.push_back({name, entry->d_type});
+                    if (pending.size() >= SCAN_BATCH_SIZE) {
+                        flush(worker, fd, dir, relative, pending, directories);
+                    }
+                }
+            }
+        }
+        if (!pending.empty()) {
+            flush(worker, fd, dir, relative, pending, directories);
+        }
+        worker.syscalls++;
+        close(fd);
+        if (!directories.empty()) {
+            sink(directories);
+        }
+    }
+
+    static std::string child_name(const std::string& relative, const char* name) {
+        return relative.empty() ? std::string(name) : relative + '/' + name;
+    }
+
+    // statx de las entradas pendientes de un directorio y entrega de los archivos regulares.
+    void flush(ScanWorker& worker, int fd, const fs::path& dir, const std::string& relative,
+               std::vector<PendingEntry>& pending, std::vector<FileRecord>& directories) {
+        std::vector<MetadataRequest> requests(pending.size());
+        for (size_t i = 0; i < pending.size(); ++i) {
+            requests[i].name = pending[i].name.c_str();
+            requests[i].follow = pending[i].type == DT_LNK; // Solo cuenta si apunta a un archivo
+        }
+        worker.metadata.collect(fd, requests);
+
+        // Sin d_type (algunos sistemas de archivos) el tipo sale del statx: los enlaces hay
+        // que volver a mirarlos siguiéndolos.
+        std::vector<size_t> links;
+        std::vector<FileRecord> batch;
+        for (size_t i = 0; i < pending.size(); ++i) {
+            const MetadataRequest& request = requests[i];
+            if (request.error != 0) {
+                if (pending[i].type == DT_REG && request.error != ENOENT) {
+                    fail(request.error, dir / pending[i].name);
+                }
+                continue;
+            }
+            if (pending[i].type == DT_UNKNOWN) {
+                if (S_ISDIR(request.mode)) {
+                    spawn(dir / pending[i].name, child_name(relative, pending[i].name.c_str()), directories);
+                    continue;
+                }
+                if (S_ISLNK(request.mode)) {
+                    links.push_back(i);
+                    continue;
+                }
+            }
+            if (!S_ISREG(request.mode)) continue;
+            batch.push_back(make_record(dir, relative, pending[i].name, request));
+        }
+        if (!links.empty()) {
+            std::vector<MetadataRequest> followed(links.size());
+            for (size_t k = 0; k < links.size(); ++k) {
+                followed[k].name = pending[links[k]].name.c_str();
+                followed[k].follow = true;
+            }
+            worker.metadata.collect(fd, followed);
+            for (size_t k = 0; k < links.size(); ++k) {
+                if (followed[k].error == 0 && S_ISREG(followed[k].mode)) {
+                    batch.push_back(make_record(dir, relative, pending[links[k]].name, followed[k]));
+                }
+            }
+        }
+        pending.clear();
+        worker.files += batch.size();
+        if (!batch.empty()) {
+            sink(batch);
+        }
+    }
+
+    static FileRecord make_record(const fs::path& dir, const std::string& relative, const std::string& name,
+                                  const MetadataRequest& request) {
+        FileRecord record;
+        record.path = dir / name;
+        record.relative = child_name(relative, name.c_str());
+        record.size = request.size;
+        record.mode = request.mode;
+        record.mtime_ns = request.mtime_ns;
+        record.inode = request.inode;
+        return record;
+    }
+
+    const ScanSink& sink;
+    bool with_directories;
+    TaskGroup group{Lane::Io};
+    std::vector<std::unique_ptr<ScanWorker>> workers; // Uno por hilo del carril Io, al usarse
+    std::atomic<bool> failed{false};
+    std::mutex mutex;
+    std::error_code error;
+    fs::path error_path;
+};
+
+} // namespace
+
+bool scan_tree(const fs::path& root, const ScanSink& sink, std::error_code& ec, fs::path& where,
+               ScanStats* stats, bool with_directories) {
+    TreeScan scan(sink, with_directories);
+    return scan.run(root, ec, where, stats);
+}
+
+std::vector<FileRecord> scan_tree(const fs::path& root, ScanStats* stats, bool with_directories) {
+    std::vector<FileRecord> files;
+    std::mutex mutex;
+    std::error_code ec;
+    fs::path where;
+    bool ok = scan_tree(root, [&](std::vector<FileRecord>& batch) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::move(batch.begin(), batch.end(), std::back_inserter(files));
+    }, ec, where, stats, with_directories);
+    if (!ok) {
+        throw fs::filesystem_error("no se pudo recorrer la carpeta", where, ec);
+    }
+    // El orden de getdents64 depende del sistema de archivos y del reparto entre hilos.
+    std::sort(files.begin(), files.end(),
+              [](const FileRecord& a, const FileRecord& b) { return a.relative < b.relative; });
+    return files;
+}
+
+void add_scan_stats(ScanStats& total, const ScanStats& other) {
+    total.files += other.files;
+    total.directories += other.directories;
+    total.syscalls += other.syscalls;
+    total.uring = total.uring || other.uring;
+    if (other.order != ReadOrder::Path) total.order = other.order;
+    if (other.readers > 0 && (total.readers == 0 || other.readers < total.readers)) total.readers = other.readers;
+}
+
+const char* read_order_name(ReadOrder order) {
+    switch (order) {
+    case ReadOrder::Inode:
+        return "inodo";
+    case ReadOrder::Extent:
+        return "fisico";
+    default:
+        return "ruta";
+    }
+}
+
+ReadSchedule choose_read_schedule(const fs::path& root) {
+    ReadSchedule schedule;
+    const char* env = std::getenv("BACKUP_TOOL_READ_ORDER");
+    std::string forced = env ? env : "";
+    if (forced == "ruta") {
+        schedule.order = ReadOrder::Path;
+    } else if (forced == "inodo") {
+        schedule.order = ReadOrder::Inode;
+    } else if (forced == "fisico") {
+        schedule.order = ReadOrder::Extent;
+    } else {
+        schedule.order = path_is_rotational(root) ? ReadOrder::Extent : ReadOrder::Path;
+    }
+    schedule.readers = schedule.order == ReadOrder::Path ? 0 : ROTATIONAL_READERS;
+    return schedule;
+}
+
+// Posición física del primer extent de 'path' (FIEMAP con un solo extent, sin
+// FIEMAP_FLAG_SYNC: no hace falta escribir lo pendiente para ordenar). 'position' queda en 0
+// si el archivo no tiene extents. Devuelve false si el sistema de archivos no admite FIEMAP.
+static bool first_extent(const fs::path& path, uint64_t& position) {
+    position = 0;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+    if (fd < 0 && errno == EPERM) {
+        fd = open(path.c_str(), O_RDONLY | O_CLOEXEC); // O_NOATIME solo vale para el dueño
+    }
+    if (fd < 0) return true; // No se puede abrir: ya fallará al leerlo
+    alignas(struct fiemap) unsigned char buffer[sizeof(struct fiemap) + sizeof(struct fiemap_extent)] = {};
+    struct fiemap* map = reinterpret_cast<struct fiemap*>(buffer);
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+    int result = ioctl(fd, FS_IOC_FIEMAP, map);
+    int error = errno;
+    close(fd);
+    if (result != 0) return error != EOPNOTSUPP && error != ENOTTY;
+    if (map->fm_mapped_extents > 0 && !(map->fm_extents[0].fe_flags & FIEMAP_EXTENT_UNKNOWN)) {
+        position = map->fm_extents[0].fe_physical;
+    }
+    return true;
+}
+
+ReadOrder sort_for_reading(std::vector<FileRecord>& files, ReadOrder order) {
+    if (order == ReadOrder::Path) return order;
+    // El orden de inodo también desempata los archivos sin extents.
+    std::sort(files.begin(), files.end(), [](const FileRecord& a, const FileRecord& b) { return a.inode < b.inode; });
+    if (order == ReadOrder::Inode) return order;
+
+    std::vector<uint64_t> positions(files.size(), 0);
+    std::atomic<bool> supported{true};
+    parallel_for(Lane::Io, files.size(), [&](size_t i) {
+        if (supported.load(std::memory_order_relaxed) && !first_extent(files[i].path, positions[i])) {
+            supported = false;
+        }
+    });
+    if (!supported) return ReadOrder::Inode;
+
+    std::vector<size_t> index(files.size());
+    for (size_t i = 0; i < index.size(); ++i) index[i] = i;
+    std::stable_sort(index.begin(), index.end(), [&](size_t a, size_t b) { return positions[a] < positions[b]; });
+    std::vector<FileRecord> sorted;
+    sorted.reserve(files.size());
+    for (size_t i : index) sorted.push_back(std::move(files[i]));
+    files = std::move(sorted);
+    return order;
+}
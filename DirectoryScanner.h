@@ -0,0 +1,92 @@
+#ifndef DIRECTORY_SCANNER_H
+#define DIRECTORY_SCANNER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Archivo regular encontrado al recorrer una carpeta, con los datos de su stat. 'relative' es
+// la ruta respecto a la carpeta recorrida, con '/' como separador.
+struct FileRecord {
+    fs::path path;
+    std::string relative;
+    uint64_t size = 0;
+    uint32_t mode = 0;
+    int64_t mtime_ns = 0;
+    uint64_t inode = 0;
+};
+
+// Recibe los archivos de un directorio (en lotes de hasta SCAN_BATCH_SIZE). Se llama desde
+// varios hilos a la vez: quien lo implemente debe sincronizarse.
+using ScanSink = std::function<void(std::vector<FileRecord>& batch)>;
+constexpr size_t SCAN_BATCH_SIZE = 4096;
+
+// Orden en que se leen los archivos de un recorrido:
+// - Path: por ruta relativa, el de scan_tree. Con un SSD da igual el orden y se lee con todos
+//   los hilos del carril Io a la vez.
+// - Inode: por número de inodo. En ext4 y XFS los inodos cercanos están en el mismo grupo de
+//   bloques, así que en un disco rotacional se aproxima al orden físico sin coste extra.
+// - Extent: por la posición en el disco del primer extent de cada archivo (ioctl FIEMAP). Es
+//   el que menos mueve el cabezal, a cambio de un open y un ioctl por archivo.
+enum class ReadOrder { Path, Inode, Extent };
+// "ruta", "inodo" o "fisico" (los valores de BACKUP_TOOL_READ_ORDER).
+const char* read_order_name(ReadOrder order);
+
+// Cómo leer los archivos de una carpeta: en qué orden y cuántos a la vez (0: los que den el
+// carril Io y io_queue_depth()).
+struct ReadSchedule {
+    ReadOrder order = ReadOrder::Path;
+    unsigned readers = 0;
+};
+// Lecturas a la vez en un disco rotacional: dos, para que el disco no se quede parado entre
+// un archivo y el siguiente sin volver a desordenar las lecturas.
+constexpr unsigned ROTATIONAL_READERS = 2;
+
+// Elige el orden según el disco de 'root' (path_is_rotational): Extent con pocos lectores en
+// un disco rotacional y Path con el reparto ancho en un SSD. La variable de entorno
+// BACKUP_TOOL_READ_ORDER (ruta, inodo o fisico) fuerza el orden; con "ruta" se lee en ancho.
+ReadSchedule choose_read_schedule(const fs::path& root);
+
+// Ordena 'files' para leerlos en 'order'. Los archivos sin extents (vacíos o con los datos
+// dentro del inodo) van primero. Si el sistema de archivos no admite FIEMAP se queda en orden
+// de inodo. Devuelve el orden aplicado.
+ReadOrder sort_for_reading(std::vector<FileRecord>& files, ReadOrder order);
+
+// Resumen de un recorrido. 'syscalls' cuenta todas las llamadas al sistema del recorrido y de
+// los metadatos (open, getdents64, close y statx o io_uring_enter).
+struct ScanStats {
+    uint64_t files = 0;
+    uint64_t directories = 0;
+    uint64_t syscalls = 0;
+    bool uring = false; // Los statx fueron por io_uring
+    // Orden de lectura que se aplicó y lecturas a la vez (0: reparto ancho), si se eligieron.
+    ReadOrder order = ReadOrder::Path;
+    unsigned readers = 0;
+};
+
+// Recorre 'root' con un directorio por tarea en el carril Io del planificador (robo de
+// trabajo): cada subdirectorio encontrado se encola y lo toma el primer hilo libre. Los
+// nombres y el tipo de cada entrada salen de getdents64 (d_type), así que los directorios no
+// necesitan stat; los archivos de cada directorio pasan en lote por la etapa de metadatos
+// (MetadataCollector), con un statx por archivo. Los enlaces simbólicos a archivos se incluyen
+// y los enlaces a directorios no se siguen, como en fs::recursive_directory_iterator.
+// Con 'with_directories' también se entregan los subdirectorios, con 'mode' S_IFDIR (sin
+// permisos: los directorios no llevan stat).
+// Si un directorio no se puede leer devuelve false con el error en 'ec' y la ruta en 'where'.
+bool scan_tree(const fs::path& root, const ScanSink& sink, std::error_code& ec, fs::path& where,
+               ScanStats* stats = nullptr, bool with_directories = false);
+
+// Igual, pero devuelve todos los archivos ordenados por 'relative' (cada directorio antes que
+// su contenido). Lanza fs::filesystem_error si no se puede recorrer alguna carpeta.
+std::vector<FileRecord> scan_tree(const fs::path& root, ScanStats* stats = nullptr, bool with_directories = false);
+
+// Suma los contadores de 'other' a 'total'. Del orden de lectura queda el más restrictivo: si
+// alguna carpeta está en un disco rotacional, el respaldo entero lee con pocos lectores.
+void add_scan_stats(ScanStats& total, const ScanStats& other);
+
+#endif // DIRECTORY_SCANNER_H
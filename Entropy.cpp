@@ -0,0 +1,69 @@
+#include "Entropy.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+
+// A partir de esta entropía (bits por byte) deflate/zstd apenas ganan unos pocos por ciento.
+static constexpr double ENTROPY_THRESHOLD = 7.5;
+// Con muestras muy pequeñas el histograma no es representativo.
+static constexpr size_t MIN_SAMPLE = 512;
+
+bool has_compressed_extension(const fs::path& path) {
+    static const std::unordered_set<std::string> extensions = {
+        // Imágenes
+        ".jpg", ".jpeg", ".png", ".gif", ".webp", ".heic", ".heif", ".avif", ".jxl",
+        // Audio y video
+        ".mp3", ".aac", ".m4a", ".ogg", ".opus", ".flac", ".mp4", ".m4v", ".mkv", ".mov",
+        ".avi", ".webm", ".wmv",
+        // Archivos comprimidos y paquetes
+        ".zip", ".gz", ".tgz", ".bz2", ".tbz2", ".xz", ".txz", ".zst", ".lz4", ".7z", ".rar",
+        ".jar", ".apk", ".deb", ".rpm", ".cab", ".br",
+        // Documentos que internamente son ZIP
+        ".docx", ".xlsx", ".pptx", ".odt", ".ods", ".odp", ".epub",
+    };
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return extensions.count(ext) > 0;
+}
+
+double sample_entropy(const unsigned char* data, size_t len) {
+    if (len == 0) return 0.0;
+
+    // Cuatro histogramas parciales: bytes consecutivos iguales no se pisan el mismo contador
+    // y el bucle no queda serializado por la dependencia entre incrementos.
+    std::array<std::array<uint32_t, 256>, 4> partial{};
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        ++partial[0][data[i]];
+        ++partial[1][data[i + 1]];
+        ++partial[2][data[i + 2]];
+        ++partial[3][data[i + 3]];
+    }
+    for (; i < len; ++i) {
+        ++partial[0][data[i]];
+    }
+
+    // Reducción sobre los 256 valores: bucle sin dependencias que el compilador vectoriza.
+    double entropy = 0.0;
+    const double inv_len = 1.0 / static_cast<double>(len);
+    for (int b = 0; b < 256; ++b) {
+        uint32_t count = partial[0][b] + partial[1][b] + partial[2][b] + partial[3][b];
+        double p = count * inv_len;
+        entropy -= count ? p * std::log2(p) : 0.0;
+    }
+    return entropy;
+}
+
+bool worth_compressing(const fs::path& path, const unsigned char* sample, size_t len) {
+    if (has_compressed_extension(path)) {
+        return false;
+    }
+    if (len < MIN_SAMPLE) {
+        return true;
+    }
+    return sample_entropy(sample, std::min(len, ENTROPY_SAMPLE_SIZE)) < ENTROPY_THRESHOLD;
+}
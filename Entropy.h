@@ -0,0 +1,22 @@
+#ifndef ENTROPY_H
+#define ENTROPY_H
+
+#include <cstddef>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Cantidad de bytes del inicio del archivo que se usan para estimar la entropía.
+constexpr size_t ENTROPY_SAMPLE_SIZE = 8 * 1024;
+
+// Extensiones de formatos que ya vienen comprimidos (JPEG, MP4, ZIP, gzip...).
+bool has_compressed_extension(const fs::path& path);
+
+// Entropía de Shannon en bits por byte (0 a 8) del histograma de bytes de la muestra.
+double sample_entropy(const unsigned char* data, size_t len);
+
+// Decide si vale la pena comprimir: false si la extensión es de un formato comprimido
+// o si la muestra tiene una entropía tan alta que no se va a reducir.
+bool worth_compressing(const fs::path& path, const unsigned char* sample, size_t len);
+
+#endif // ENTROPY_H
@@ -0,0 +1,154 @@
+#include "FileManifest.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char MANIFEST_MAGIC[4] = {'B', 'T', 'M', 'F'};
+static constexpr uint32_t MANIFEST_VERSION = 1;
+
+struct ManifestHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+    uint64_t strings_size;
+    uint64_t reserved;
+};
+
+struct FileManifest::Record {
+    uint64_t path_offset; // Dentro de la zona de rutas
+    uint32_t path_len;
+    uint32_t crc;
+    uint64_t size;
+    int64_t mtime_ns;
+    uint64_t inode;
+};
+
+static_assert(sizeof(ManifestHeader) == 32, "cabecera del manifiesto");
+
+FileManifest::~FileManifest() {
+    if (mapping) {
+        munmap(mapping, mapping_size);
+    }
+}
+
+bool FileManifest::load(const fs::path& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ManifestHeader)) {
+        close(fd);
+        return false;
+    }
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    const ManifestHeader* header = static_cast<const ManifestHeader*>(map);
+    uint64_t file_size = st.st_size;
+    // Cada término se acota por el tamaño del archivo antes de sumarlos, para que la suma no desborde.
+    bool valid = std::memcmp(header->magic, MANIFEST_MAGIC, 4) == 0 && header->version == MANIFEST_VERSION &&
+                 header->count <= file_size / sizeof(Record) && header->strings_size <= file_size &&
+                 sizeof(ManifestHeader) + header->count * sizeof(Record) + header->strings_size == file_size;
+    // find() y path_of() leen las rutas sin comprobar límites: se validan aquí una sola vez.
+    if (valid) {
+        const Record* record = reinterpret_cast<const Record*>(static_cast<const char*>(map) + sizeof(ManifestHeader));
+        for (uint64_t i = 0; i < header->count && valid; ++i) {
+            valid = record[i].path_offset <= header->strings_size &&
+                    record[i].path_len <= header->strings_size - record[i].path_offset;
+        }
+    }
+    if (!valid) {
+        std::cerr << "Manifiesto inválido o de otra versión: " << path << std::endl;
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    if (mapping) {
+        munmap(mapping, mapping_size);
+    }
+    mapping = map;
+    mapping_size = st.st_size;
+    count = header->count;
+    // El acceso es por búsqueda binaria: no sirve la lectura anticipada secuencial.
+    madvise(mapping, mapping_size, MADV_RANDOM);
+    return true;
+}
+
+const FileManifest::Record* FileManifest::records() const {
+    static_assert(sizeof(Record) == 40, "registro del manifiesto");
+    return reinterpret_cast<const Record*>(static_cast<const char*>(mapping) + sizeof(ManifestHeader));
+}
+
+std::string FileManifest::path_of(const Record& record) const {
+    const char* strings = reinterpret_cast<const char*>(records() + count);
+    return std::string(strings + record.path_offset, record.path_len);
+}
+
+FileState FileManifest::at(size_t index) const {
+    const Record& record = records()[index];
+    return {path_of(record), record.size, record.mtime_ns, record.inode, record.crc};
+}
+
+bool FileManifest::find(const std::string& path, FileState& state) const {
+    const Record* begin = records();
+    const Record* end = begin + count;
+    const char* strings = reinterpret_cast<const char*>(end);
+    auto compare = [&](const Record& record, const std::string& key) {
+        size_t len = std::min<size_t>(record.path_len, key.size());
+        int c = std::memcmp(strings + record.path_offset, key.data(), len);
+        return c < 0 || (c == 0 && record.path_len < key.size());
+    };
+    const Record* it = count ? std::lower_bound(begin, end, path, compare) : end;
+    if (it == end || it->path_len != path.size() ||
+        std::memcmp(strings + it->path_offset, path.data(), path.size()) != 0) {
+        return false;
+    }
+    state = {path, it->size, it->mtime_ns, it->inode, it->crc};
+    return true;
+}
+
+bool FileManifest::save(const fs::path& path, std::vector<FileState> entries) {
+    std::sort(entries.begin(), entries.end(),
+              [](const FileState& a, const FileState& b) { return a.path < b.path; });
+
+    std::vector<Record> records(entries.size());
+    std::string strings;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        records[i] = {strings.size(), static_cast<uint32_t>(entries[i].path.size()), entries[i].crc,
+                      entries[i].size, entries[i].mtime_ns, entries[i].inode};
+        strings += entries[i].path;
+    }
+    ManifestHeader header{};
+    std::memcpy(header.magic, MANIFEST_MAGIC, 4);
+    header.version = MANIFEST_VERSION;
+    header.count = records.size();
+    header.strings_size = strings.size();
+
+    fs::path tmp_path = path.string() + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+        out.write(strings.data(), strings.size());
+        if (!out) {
+            std::cerr << "Error escribiendo el manifiesto: " << tmp_path << std::endl;
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp_path, path, ec);
+    if (ec) {
+        std::cerr << "Error guardando el manifiesto: " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef FILE_MANIFEST_H
+#define FILE_MANIFEST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Estado de un archivo en el último respaldo.
+struct FileState {
+    std::string path;      // Nombre dentro del respaldo
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    uint64_t inode = 0;
+    uint32_t crc = 0;      // CRC-32 del contenido respaldado
+};
+
+// Manifiesto binario con el estado de los archivos del respaldo anterior.
+// Formato (little endian): cabecera, registros de tamaño fijo ordenados por ruta y al final
+// las rutas. Se carga con mmap y se consulta por búsqueda binaria sin parsear nada, así que
+// abrir un manifiesto con millones de entradas tarda milisegundos.
+class FileManifest {
+public:
+    FileManifest() = default;
+    ~FileManifest();
+    FileManifest(const FileManifest&) = delete;
+    FileManifest& operator=(const FileManifest&) = delete;
+
+    // Devuelve false si el archivo no existe o no es un manifiesto válido (queda vacío).
+    bool load(const fs::path& path);
+    size_t size() const { return count; }
+    FileState at(size_t index) const;
+    bool find(const std::string& path, FileState& state) const;
+
+    // Escribe un manifiesto nuevo de forma atómica (archivo temporal + rename).
+    static bool save(const fs::path& path, std::vector<FileState> entries);
+
+private:
+    struct Record;
+    const Record* records() const;
+    std::string path_of(const Record& record) const;
+
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    size_t count = 0;
+};
+
+#endif // FILE_MANIFEST_H
@@ -0,0 +1,507 @@
+#include "IoEngine.h"
+#include "IoUring.h"
+#include "Scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Cada lectura son hasta cinco SQE (abrir, quitar la lectura por adelantado, leer, soltar de
+// la caché y cerrar); el anillo tiene sitio para todas.
+static constexpr unsigned IO_RING_ENTRIES = 8 * IO_QUEUE_DEPTH;
+static constexpr size_t IO_BUFFER_ALIGNMENT = DIRECT_IO_ALIGNMENT;
+
+// Tipo de operación en el user_data de cada SQE (el resto es el índice de la lectura).
+enum : uint64_t { OP_OPEN = 0, OP_READ = 1, OP_CLOSE = 2, OP_WRITE = 3, OP_ADVISE = 4 };
+static constexpr unsigned OP_BITS = 3;
+
+static uint64_t user_data(size_t index, uint64_t op) {
+    return (static_cast<uint64_t>(index) << OP_BITS) | op;
+}
+
+static size_t index_of(uint64_t data) {
+    return static_cast<size_t>(data >> OP_BITS);
+}
+
+static uint64_t op_of(uint64_t data) {
+    return data & ((1u << OP_BITS) - 1);
+}
+
+// La lectura cumple lo que pide O_DIRECT (ver IoRead).
+static bool direct_possible(const IoRead& read) {
+    return reinterpret_cast<uintptr_t>(read.buffer) % DIRECT_IO_ALIGNMENT == 0 &&
+           read.offset % DIRECT_IO_ALIGNMENT == 0 && read.capacity >= direct_io_length(read.length);
+}
+
+static std::atomic<unsigned> depth_override{0};
+
+unsigned io_queue_depth() {
+    unsigned depth = depth_override.load(std::memory_order_relaxed);
+    if (depth > 0) return depth;
+    return IO_QUEUE_DEPTH;
+}
+
+void set_io_queue_depth(unsigned depth) {
+    depth_override.store(std::min(depth, IO_QUEUE_DEPTH), std::memory_order_relaxed);
+}
+
+void IoEngine::BufferDeleter::operator()(unsigned char* p) const {
+    std::free(p);
+}
+
+IoEngine::IoEngine(size_t buffer_size, unsigned buffer_count) : buffer_bytes(buffer_size) {
+    for (unsigned i = 0; i < buffer_count; ++i) {
+        void* p = nullptr;
+        if (posix_memalign(&p, IO_BUFFER_ALIGNMENT, std::max<size_t>(buffer_size, 1)) != 0) {
+            throw std::bad_alloc();
+        }
+        buffers.emplace_back(static_cast<unsigned char*>(p));
+    }
+
+    auto candidate = std::make_unique<IoUring>(IO_RING_ENTRIES);
+    if (!candidate->valid()) {
+        return;
+    }
+    ring = std::move(candidate);
+
+    // Buffers fijos: falla si superan RLIMIT_MEMLOCK; entonces se leen como buffers normales.
+    if (!buffers.empty()) {
+        std::vector<iovec> iov(buffers.size());
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            iov[i].iov_base = buffers[i].get();
+            iov[i].iov_len = buffer_bytes;
+        }
+        fixed_buffers = ring->register_op(IORING_REGISTER_BUFFERS, iov.data(), iov.size()) == 0;
+    }
+    // Tabla de archivos fijos vacía: los slots se llenan con IORING_OP_OPENAT directo.
+    std::vector<int> slots(IO_QUEUE_DEPTH, -1);
+    fixed_files = ring->register_op(IORING_REGISTER_FILES, slots.data(), slots.size()) == 0;
+}
+
+IoEngine::~IoEngine() {
+    ring.reset(); // Antes que los buffers registrados
+}
+
+int IoEngine::registered_index(const void* data, size_t len) const {
+    if (!fixed_buffers) return -1;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        const unsigned char* base = buffers[i].get();
+        if (p >= base && p + len <= base + buffer_bytes) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// Con O_DIRECT una lectura corta que no acaba alineada es el final del archivo (seguir
+// leyendo desde ahí daría EINVAL).
+static ssize_t pread_full(int fd, unsigned char* buf, size_t len, uint64_t offset, bool direct) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pread(fd, buf + done, len - done, offset + done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+        if (n == 0) break;
+        done += n;
+        if (direct && n % DIRECT_IO_ALIGNMENT != 0) break;
+    }
+    return static_cast<ssize_t>(done);
+}
+
+// Lectura completa con open/pread/close. Si el sistema de archivos no admite O_DIRECT (o
+// esta alineación) se repite sin él.
+static void read_one(IoRead& read, CachePolicy policy) {
+    bool direct = policy == CachePolicy::Direct && direct_possible(read);
+    int fd = ::open(read.path, O_RDONLY | O_CLOEXEC | (direct ? O_DIRECT : 0));
+    if (fd >= 0 && direct) {
+        read.result = pread_full(fd, read.buffer, direct_io_length(read.length), read.offset, true);
+        if (read.result != -EINVAL) {
+            read.open_failed = false;
+            read.result = std::min<ssize_t>(read.result, static_cast<ssize_t>(read.length));
+            ::close(fd);
+            return;
+        }
+        ::close(fd);
+        fd = -1;
+        errno = EINVAL;
+    }
+    if (fd < 0 && direct && errno == EINVAL) {
+        fd = ::open(read.path, O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        read.result = -errno;
+        read.open_failed = true;
+        return;
+    }
+    read.open_failed = false;
+    // Una sola petición por rango: la lectura por adelantado solo traería páginas de fuera del
+    // rango (que nadie soltaría), así que se quita con RANDOM y al terminar se suelta el rango.
+    if (policy != CachePolicy::Normal) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+    }
+    read.result = pread_full(fd, read.buffer, read.length, read.offset, false);
+    if (policy != CachePolicy::Normal) {
+        drop_read_pages(fd, read.offset, read.length);
+    }
+    ::close(fd);
+}
+
+void IoEngine::read_all_sync(std::vector<IoRead>& reads, const std::vector<size_t>& indices, CachePolicy policy) {
+    // Como en el anillo, no más de io_queue_depth() lecturas a la vez.
+    parallel_for_width(Lane::Io, indices.size(), io_queue_depth(), [&](size_t k) {
+        read_one(reads[indices[k]], policy);
+    });
+}
+
+// Con archivos fijos cada lectura es una cadena abrir -> leer -> (soltar) -> cerrar en un slot
+// propio; sin ellos se abre con open() y solo la lectura va por el anillo. Devuelve false si
+// el anillo dejó de servir: se termina lo que estaba en vuelo y las lecturas que no se
+// hicieron quedan con result == -ECANCELED (o -EINVAL en la apertura) para repetirlas sin
+// anillo. En 'retry' quedan las lecturas con O_DIRECT que el sistema de archivos rechazó.
+bool IoEngine::read_all_ring(std::vector<IoRead>& reads, CachePolicy policy, std::vector<size_t>& retry) {
+    unsigned depth = io_queue_depth();
+    std::vector<unsigned> free_slots(depth);
+    std::iota(free_slots.rbegin(), free_slots.rend(), 0u);
+    std::vector<unsigned> slot_of(reads.size(), 0);
+    std::vector<int> fd_of(reads.size(), -1);
+    std::vector<char> direct_of(reads.size(), 0);
+    size_t next = 0;
+    unsigned in_flight = 0;
+    bool usable = true;
+
+    for (IoRead& read : reads) {
+        read.result = -ECANCELED;
+        read.open_failed = false;
+    }
+    while (next < reads.size() || in_flight > 0) {
+        while (usable && next < reads.size() && in_flight < depth) {
+            IoRead& read = reads[next];
+            bool direct = policy == CachePolicy::Direct && direct_possible(read);
+            size_t length = direct ? direct_io_length(read.length) : read.length;
+            int buf_index = registered_index(read.buffer, length);
+            if (fixed_files) {
+                unsigned slot = free_slots.back();
+                free_slots.pop_back();
+                slot_of[next] = slot;
+                io_uring_sqe* open_sqe = ring->get_sqe();
+                open_sqe->opcode = IORING_OP_OPENAT;
+                open_sqe->fd = AT_FDCWD;
+                open_sqe->addr = reinterpret_cast<uint64_t>(read.path);
+                open_sqe->open_flags = O_RDONLY | (direct ? O_DIRECT : 0);
+                open_sqe->file_index = slot + 1;
+                open_sqe->flags = IOSQE_IO_LINK;
+                open_sqe->user_data = user_data(next, OP_OPEN);
+                if (policy != CachePolicy::Normal && !direct) {
+                    // Como en read_one: sin lectura por adelantado fuera del rango.
+                    io_uring_sqe* advise_sqe = ring->get_sqe();
+                    advise_sqe->opcode = IORING_OP_FADVISE;
+                    advise_sqe->fd = static_cast<int>(slot);
+                    advise_sqe->fadvise_advice = POSIX_FADV_RANDOM;
+                    advise_sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+                    advise_sqe->user_data = user_data(next, OP_ADVISE);
+                }
+            } else {
+                int fd = ::open(read.path, O_RDONLY | O_CLOEXEC | (direct ? O_DIRECT : 0));
+                if (fd < 0 && direct && errno == EINVAL) {
+                    direct = false;
+                    length = read.length;
+                    buf_index = registered_index(read.buffer, length);
+                    fd = ::open(read.path, O_RDONLY | O_CLOEXEC);
+                }
+                if (fd < 0) {
+                    read.result = -errno;
+                    read.open_failed = true;
+                    ++next;
+                    continue;
+                }
+                if (policy != CachePolicy::Normal && !direct) {
+                    posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+                }
+                fd_of[next] = fd;
+            }
+            direct_of[next] = direct;
+            io_uring_sqe* sqe = ring->get_sqe();
+            sqe->opcode = buf_index >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+            sqe->fd = fixed_files ? static_cast<int>(slot_of[next]) : fd_of[next];
+            sqe->addr = reinterpret_cast<uint64_t>(read.buffer);
+            sqe->len = static_cast<uint32_t>(length);
+            sqe->off = read.offset;
+            sqe->buf_index = static_cast<uint16_t>(std::max(buf_index, 0));
+            sqe->user_data = user_data(next, OP_READ);
+            if (fixed_files) {
+                // HARDLINK: el resto de la cadena va aunque la lectura falle o sea corta.
+                sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+                if (policy != CachePolicy::Normal && !direct) {
+                    io_uring_sqe* advise_sqe = ring->get_sqe();
+                    advise_sqe->opcode = IORING_OP_FADVISE;
+                    advise_sqe->fd = static_cast<int>(slot_of[next]);
+                    advise_sqe->off = read.offset;
+                    advise_sqe->len = static_cast<uint32_t>(read.length);
+                    advise_sqe->fadvise_advice = POSIX_FADV_DONTNEED;
+                    advise_sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+                    advise_sqe->user_data = user_data(next, OP_ADVISE);
+                }
+                io_uring_sqe* close_sqe = ring->get_sqe();
+                close_sqe->opcode = IORING_OP_CLOSE;
+                close_sqe->file_index = slot_of[next] + 1;
+                close_sqe->user_data = user_data(next, OP_CLOSE);
+            }
+            ++next;
+            ++in_flight;
+        }
+        if (in_flight == 0) break;
+
+        if (ring->submit(1) < 0) {
+            usable = false;
+            break;
+        }
+        while (io_uring_cqe* cqe = ring->peek()) {
+            size_t index = index_of(cqe->user_data);
+            uint64_t op = op_of(cqe->user_data);
+            int res = cqe->res;
+            ring->seen();
+            IoRead& read = reads[index];
+            if (op == OP_OPEN) {
+                if (res < 0) {
+                    read.result = res;
+                    read.open_failed = true;
+                    if (res == -EINVAL && direct_of[index]) {
+                        retry.push_back(index); // O_DIRECT no admitido aquí
+                    } else if (res == -EINVAL) {
+                        usable = false; // Kernel sin OPENAT directo a slots
+                    }
+                }
+            } else if (op == OP_READ) {
+                if (!read.open_failed) {
+                    read.result = std::min(res, static_cast<int>(read.length));
+                    if (res == -EINVAL && direct_of[index]) retry.push_back(index);
+                }
+                if (!fixed_files) {
+                    if (policy != CachePolicy::Normal && !direct_of[index]) {
+                        drop_read_pages(fd_of[index], read.offset, read.length);
+                    }
+                    ::close(fd_of[index]);
+                    --in_flight;
+                }
+            } else if (op == OP_CLOSE) {
+                free_slots.push_back(slot_of[index]);
+                --in_flight;
+            }
+            // OP_ADVISE: es solo un consejo, su resultado no importa.
+        }
+    }
+    return usable;
+}
+
+void IoEngine::read_all(std::vector<IoRead>& reads) {
+    CachePolicy policy = cache_policy();
+    std::vector<size_t> retry;
+    if (ring && !read_all_ring(reads, policy, retry)) {
+        // El kernel no admite alguna operación: el resto con pread en el pool.
+        fixed_files = false;
+        ring.reset();
+        retry.clear();
+        for (size_t i = 0; i < reads.size(); ++i) {
+            if (reads[i].result == -ECANCELED || (reads[i].open_failed && reads[i].result == -EINVAL)) {
+                retry.push_back(i);
+            }
+        }
+        read_all_sync(reads, retry, policy);
+        return;
+    }
+    if (!ring) {
+        retry.resize(reads.size());
+        std::iota(retry.begin(), retry.end(), 0);
+    }
+    read_all_sync(reads, retry, policy);
+}
+
+int IoEngine::open_fixed(const char* path, int flags, mode_t mode, unsigned slot) {
+    io_uring_sqe* sqe = ring->get_sqe();
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<uint64_t>(path);
+    sqe->open_flags = static_cast<uint32_t>(flags);
+    sqe->len = mode;
+    sqe->file_index = slot + 1;
+    sqe->user_data = user_data(0, OP_OPEN);
+    int ret = ring->submit(1);
+    if (ret < 0) return ret;
+    io_uring_cqe* cqe = ring->peek();
+    int res = cqe ? cqe->res : -EIO;
+    if (cqe) ring->seen();
+    return res < 0 ? res : 0;
+}
+
+int IoEngine::close_fixed(unsigned slot) {
+    io_uring_sqe* sqe = ring->get_sqe();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = slot + 1;
+    sqe->user_data = user_data(0, OP_CLOSE);
+    int ret = ring->submit(1);
+    if (ret < 0) return ret;
+    io_uring_cqe* cqe = ring->peek();
+    int res = cqe ? cqe->res : -EIO;
+    if (cqe) ring->seen();
+    return res;
+}
+
+IoFileWriter::~IoFileWriter() {
+    if (opened) close();
+}
+
+bool IoFileWriter::use_ring() const {
+    return engine.ring && engine.buffer_count() > 0;
+}
+
+bool IoFileWriter::open(const fs::path& path, mode_t mode) {
+    offset = 0;
+    fill = 0;
+    current = 0;
+    in_flight = 0;
+    err = 0;
+    fixed = false;
+    fd = -1;
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    if (use_ring() && engine.fixed_files) {
+        int res = engine.open_fixed(path.c_str(), flags, mode, 0);
+        if (res == 0) {
+            fixed = true;
+        } else if (res != -EINVAL) {
+            err = -res;
+            return false;
+        } else {
+            engine.fixed_files = false; // Kernel sin OPENAT directo: descriptores normales
+        }
+    }
+    if (!fixed) {
+        fd = ::open(path.c_str(), flags | O_CLOEXEC, mode);
+        if (fd < 0) {
+            err = errno;
+            return false;
+        }
+    }
+    busy.assign(engine.buffer_count(), false);
+    lengths.assign(engine.buffer_count(), 0);
+    opened = true;
+    return true;
+}
+
+// Procesa una completion de escritura, esperándola si no hay ninguna lista. Los errores de
+// la escritura quedan en 'err'; devuelve false solo si no se puede esperar al anillo.
+bool IoFileWriter::wait_one() {
+    io_uring_cqe* cqe = engine.ring->peek();
+    if (!cqe) {
+        int ret = engine.ring->submit(1);
+        if (ret < 0) {
+            if (!err) err = -ret;
+            return false;
+        }
+        cqe = engine.ring->peek();
+        if (!cqe) return true;
+    }
+    unsigned index = static_cast<unsigned>(index_of(cqe->user_data));
+    int res = cqe->res;
+    engine.ring->seen();
+    busy[index] = false;
+    --in_flight;
+    if (res < 0) {
+        if (!err) err = -res;
+    } else if (static_cast<size_t>(res) < lengths[index]) {
+        // En un archivo regular una escritura solo queda corta si no hay espacio.
+        if (!err) err = ENOSPC;
+    }
+    return true;
+}
+
+bool IoFileWriter::submit_current() {
+    if (fill == 0) return true;
+    io_uring_sqe* sqe = engine.ring->get_sqe();
+    while (!sqe) {
+        if (!wait_one()) return false;
+        sqe = engine.ring->get_sqe();
+    }
+    int buf_index = engine.registered_index(engine.buffer(current), fill);
+    sqe->opcode = buf_index >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = fixed ? 0 : fd;
+    sqe->flags = fixed ? IOSQE_FIXED_FILE : 0;
+    sqe->addr = reinterpret_cast<uint64_t>(engine.buffer(current));
+    sqe->len = static_cast<uint32_t>(fill);
+    sqe->off = offset;
+    sqe->buf_index = static_cast<uint16_t>(std::max(buf_index, 0));
+    sqe->user_data = user_data(current, OP_WRITE);
+    // El envío no espera: la escritura sigue en el kernel mientras se llena el siguiente.
+    int ret = engine.ring->submit(0);
+    if (ret < 0) {
+        if (!err) err = -ret;
+        return false;
+    }
+    busy[current] = true;
+    lengths[current] = fill;
+    ++in_flight;
+    offset += fill;
+    fill = 0;
+    // Siguiente buffer libre; si están todos en vuelo, esperar a que termine uno.
+    for (;;) {
+        for (unsigned k = 1; k <= busy.size(); ++k) {
+            unsigned candidate = (current + k) % busy.size();
+            if (!busy[candidate]) {
+                current = candidate;
+                return err == 0;
+            }
+        }
+        if (!wait_one()) return false;
+    }
+}
+
+bool IoFileWriter::write(const void* data, size_t len) {
+    if (!opened || err) return false;
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    if (!use_ring()) {
+        while (len > 0) {
+            ssize_t n = pwrite(fd, bytes, len, static_cast<off_t>(offset));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                err = errno;
+                return false;
+            }
+            bytes += n;
+            len -= static_cast<size_t>(n);
+            offset += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+    while (len > 0) {
+        size_t n = std::min(len, engine.buffer_size() - fill);
+        std::memcpy(engine.buffer(current) + fill, bytes, n);
+        fill += n;
+        bytes += n;
+        len -= n;
+        if (fill == engine.buffer_size() && !submit_current()) return false;
+    }
+    return true;
+}
+
+bool IoFileWriter::close() {
+    if (!opened) return false;
+    opened = false;
+    if (use_ring()) {
+        if (!err) submit_current();
+        while (in_flight > 0 && wait_one()) {
+        }
+    }
+    if (fixed) {
+        int res = engine.close_fixed(0);
+        if (res < 0 && !err) err = -res;
+    } else if (fd >= 0) {
+        if (::close(fd) != 0 && !err) err = errno;
+        fd = -1;
+    }
+    return err == 0;
+}
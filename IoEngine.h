@@ -0,0 +1,124 @@
+#ifndef IO_ENGINE_H
+#define IO_ENGINE_H
+
+#include "PageCache.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <filesystem>
+#include <sys/types.h>
+
+namespace fs = std::filesystem;
+
+// IoUring.h trae <linux/fs.h>, cuyas macros (BLOCK_SIZE...) chocan con otros módulos.
+class IoUring;
+
+// Operaciones en vuelo a la vez en el anillo (lecturas o escrituras): IO_QUEUE_DEPTH es el
+// máximo (los slots de la tabla de archivos fijos) y io_queue_depth() las que se usan.
+constexpr unsigned IO_QUEUE_DEPTH = 32;
+unsigned io_queue_depth();
+// Fija las operaciones en vuelo (como mucho IO_QUEUE_DEPTH) para todo el proceso, por ejemplo
+// pocas lecturas a la vez en el orden físico de un disco rotacional. 0 vuelve al valor por
+// defecto.
+void set_io_queue_depth(unsigned depth);
+
+// Una lectura de read_all: 'length' bytes de 'path' desde 'offset' en 'buffer'. Al volver,
+// 'result' son los bytes leídos o -errno ('open_failed' indica que falló la apertura).
+// Con CachePolicy::Direct solo se usa O_DIRECT si 'buffer' y 'offset' están alineados a
+// DIRECT_IO_ALIGNMENT y 'capacity' (lo que cabe en 'buffer') llega a direct_io_length(length).
+struct IoRead {
+    const char* path = nullptr;
+    uint64_t offset = 0;
+    unsigned char* buffer = nullptr;
+    size_t length = 0;
+    size_t capacity = 0;
+    ssize_t result = 0;
+    bool open_failed = false;
+};
+
+// Motor de E/S sobre io_uring. Los buffers del motor quedan registrados en el kernel
+// (READ_FIXED/WRITE_FIXED, sin mapear las páginas en cada operación) y los archivos se abren
+// directamente en la tabla de archivos fijos del anillo: una lectura completa (abrir, leer y
+// cerrar) son tres SQE enlazadas y un lote entero cuesta unas pocas llamadas a io_uring_enter.
+// Si el kernel no tiene io_uring se usan pread/pwrite en el carril Io del planificador, y si no admite
+// buffers o archivos fijos, operaciones normales del anillo.
+// El anillo es de un solo hilo: cada hilo que lee o escribe necesita su IoEngine.
+class IoEngine {
+public:
+    // Reserva 'buffer_count' buffers de 'buffer_size' bytes para quien use el motor.
+    IoEngine(size_t buffer_size = 0, unsigned buffer_count = 0);
+    ~IoEngine();
+    IoEngine(const IoEngine&) = delete;
+    IoEngine& operator=(const IoEngine&) = delete;
+
+    unsigned char* buffer(unsigned index) { return buffers[index].get(); }
+    unsigned buffer_count() const { return static_cast<unsigned>(buffers.size()); }
+    size_t buffer_size() const { return buffer_bytes; }
+    bool uses_uring() const { return ring != nullptr; }
+
+    // Hace todas las lecturas con hasta io_queue_depth() en vuelo, siguiendo cache_policy():
+    // con DropBehind lo leído se suelta de la caché y con Direct se lee con O_DIRECT.
+    void read_all(std::vector<IoRead>& reads);
+
+private:
+    friend class IoFileWriter;
+
+    struct BufferDeleter {
+        void operator()(unsigned char* p) const;
+    };
+
+    // Índice del buffer registrado que contiene [data, data + len), o -1.
+    int registered_index(const void* data, size_t len) const;
+    void read_all_sync(std::vector<IoRead>& reads, const std::vector<size_t>& indices, CachePolicy policy);
+    bool read_all_ring(std::vector<IoRead>& reads, CachePolicy policy, std::vector<size_t>& retry);
+    // Abre 'path' en el slot 'slot' de la tabla de archivos fijos (una sola llamada).
+    int open_fixed(const char* path, int flags, mode_t mode, unsigned slot);
+    int close_fixed(unsigned slot);
+
+    std::unique_ptr<IoUring> ring;
+    std::vector<std::unique_ptr<unsigned char[], BufferDeleter>> buffers;
+    size_t buffer_bytes = 0;
+    bool fixed_buffers = false;
+    bool fixed_files = false;
+};
+
+// Escritura secuencial de un archivo a través de un IoEngine: los datos se copian a los
+// buffers del motor y cada buffer lleno se envía como una escritura en su posición, con
+// varias en vuelo mientras quien escribe sigue produciendo datos (por ejemplo, el
+// descompresor). Sin io_uring escribe directamente con pwrite. Solo puede haber un
+// IoFileWriter abierto por motor.
+class IoFileWriter {
+public:
+    explicit IoFileWriter(IoEngine& engine) : engine(engine) {}
+    ~IoFileWriter();
+    IoFileWriter(const IoFileWriter&) = delete;
+    IoFileWriter& operator=(const IoFileWriter&) = delete;
+
+    bool open(const fs::path& path, mode_t mode = 0644);
+    bool write(const void* data, size_t len);
+    // Espera a las escrituras pendientes y cierra. Devuelve false si alguna falló.
+    bool close();
+    bool is_open() const { return opened; }
+    // errno del primer error.
+    int error() const { return err; }
+
+private:
+    bool use_ring() const;
+    bool submit_current();
+    bool wait_one();
+
+    IoEngine& engine;
+    bool opened = false;
+    int fd = -1;           // Descriptor normal (sin archivos fijos)
+    bool fixed = false;    // Abierto en el slot 0 de la tabla de archivos fijos
+    uint64_t offset = 0;   // Bytes ya enviados a escribir
+    std::vector<bool> busy;
+    std::vector<size_t> lengths; // Bytes enviados desde cada buffer en vuelo
+    unsigned current = 0;  // Buffer que se está llenando
+    size_t fill = 0;
+    unsigned in_flight = 0;
+    int err = 0;
+};
+
+#endif // IO_ENGINE_H
@@ -0,0 +1,124 @@
+#include "IoUring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+IoUring::IoUring(unsigned entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ring_fd < 0) {
+        return;
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                   IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        sq_ring = nullptr;
+        close(ring_fd);
+        return;
+    }
+    if (single_mmap) {
+        cq_ring = sq_ring;
+    } else {
+        cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                       IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) {
+            cq_ring = nullptr;
+            munmap(sq_ring, sq_ring_size);
+            sq_ring = nullptr;
+            close(ring_fd);
+            return;
+        }
+    }
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqe_map = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                         IORING_OFF_SQES);
+    if (sqe_map == MAP_FAILED) {
+        if (cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+        munmap(sq_ring, sq_ring_size);
+        sq_ring = cq_ring = nullptr;
+        close(ring_fd);
+        return;
+    }
+    sqes = static_cast<io_uring_sqe*>(sqe_map);
+
+    char* sq = static_cast<char*>(sq_ring);
+    char* cq = static_cast<char*>(cq_ring);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    sq_entries = params.sq_entries;
+    local_tail = *sq_tail;
+    fd = ring_fd;
+}
+
+IoUring::~IoUring() {
+    if (fd < 0) return;
+    munmap(sqes, sqes_size);
+    if (cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+    munmap(sq_ring, sq_ring_size);
+    close(fd);
+}
+
+io_uring_sqe* IoUring::get_sqe() {
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (local_tail - head >= sq_entries) {
+        return nullptr;
+    }
+    unsigned index = local_tail & *sq_mask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    local_tail++;
+    to_submit++;
+    return sqe;
+}
+
+int IoUring::submit(unsigned wait_nr) {
+    // Publicar las SQE nuevas antes de avisar al kernel.
+    __atomic_store_n(sq_tail, local_tail, __ATOMIC_RELEASE);
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    for (;;) {
+        int ret = static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, wait_nr, flags, nullptr, 0));
+        if (ret >= 0) {
+            to_submit -= static_cast<unsigned>(ret);
+            return ret;
+        }
+        if (errno != EINTR) {
+            return -errno;
+        }
+    }
+}
+
+int IoUring::register_op(unsigned opcode, const void* arg, unsigned nr_args) {
+    int ret = static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+    return ret < 0 ? -errno : ret;
+}
+
+io_uring_cqe* IoUring::peek() {
+    unsigned head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+        return nullptr;
+    }
+    return &cqes[head & *cq_mask];
+}
+
+void IoUring::seen() {
+    __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,55 @@
+#ifndef IO_URING_H
+#define IO_URING_H
+
+#include <cstddef>
+#include <linux/io_uring.h>
+
+// Anillo de io_uring mínimo sobre las llamadas al sistema (sin liburing): una cola de envío y
+// una de completions mapeadas en memoria. Si el kernel no tiene io_uring o está desactivado
+// (/proc/sys/kernel/io_uring_disabled, seccomp en contenedores), valid() es false y quien lo
+// use debe recurrir a las llamadas normales. Cada anillo es de un solo hilo.
+class IoUring {
+public:
+    explicit IoUring(unsigned entries);
+    ~IoUring();
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    bool valid() const { return fd >= 0; }
+    unsigned capacity() const { return sq_entries; }
+
+    // Siguiente SQE libre, a cero, o nullptr si la cola de envío está llena.
+    io_uring_sqe* get_sqe();
+    // Envía las SQE preparadas y espera a que haya al menos 'wait_nr' completions (una sola
+    // llamada a io_uring_enter). Devuelve cuántas envió o -errno.
+    int submit(unsigned wait_nr);
+    // io_uring_register (buffers o archivos fijos). Devuelve 0 o -errno.
+    int register_op(unsigned opcode, const void* arg, unsigned nr_args);
+    // Completion más antigua sin consumir, o nullptr. seen() la libera.
+    io_uring_cqe* peek();
+    void seen();
+
+private:
+    int fd = -1;
+    unsigned sq_entries = 0;
+    void* sq_ring = nullptr;
+    void* cq_ring = nullptr;
+    size_t sq_ring_size = 0;
+    size_t cq_ring_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    unsigned local_tail = 0; // SQE preparadas y todavía no publicadas al kernel
+    unsigned to_submit = 0;
+};
+
+#endif // IO_URING_H
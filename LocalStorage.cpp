@@ -1,9 +1,6 @@
 #include "LocalStorage.h"
 #include "utils.h"
 #include <filesystem>
-#include <algorithm>
-#include <execution>
-#include <mutex>
 #include <iostream>
 #include <cstdlib>
 
@@ -24,70 +21,53 @@ bool LocalStorage::validate() {
 }
 
 bool LocalStorage::backup(const std::vector<std::string>& folders) {
-    // Crear la carpeta de respaldo
-    fs::path backup_folder = fs::path(destination_folder) / backup_name;
-    try {
-        if (fs::exists(backup_folder)) {
-            show_message("La carpeta de respaldo ya existe. Se sobrescribirá.");
-            fs::remove_all(backup_folder);
-        }
-        fs::create_directories(backup_folder);
-    } catch (const std::exception& e) {
-        show_message("Error creando la carpeta de respaldo: " + std::string(e.what()));
-        return false;
-    }
+    // Los archivos se leen desde las carpetas originales y se escriben directamente en el ZIP,
+    // sin copia intermedia ni limpieza posterior.
+    fs::path zip_path = fs::path(destination_folder) / (backup_name + ".zip");
 
-    // Copiar todas las carpetas seleccionadas en paralelo
-    std::vector<bool> copy_results(folders.size());
-    std::mutex error_mutex;
     std::vector<std::string> error_messages;
+    for (const auto& folder : folders) {
+        if (!fs::is_directory(fs::path(folder))) {
+            error_messages.push_back("Carpeta no válida: " + folder);
+        }
+    }
 
-    std::transform(std::execution::par_unseq, folders.begin(), folders.end(), copy_results.begin(),
-        [&](const std::string& folder) -> bool {
-            fs::path source_path(folder);
-            if (fs::is_directory(source_path)) {
-                fs::path dest_path = backup_folder / source_path.filename();
-                try {
-                    if (!copy_directory(source_path, dest_path)) {
-                        std::lock_guard<std::mutex> lock(error_mutex);
-                        error_messages.push_back("Error copiando la carpeta: " + folder);
-                        return false;
-                    }
-                    return true;
-                } catch (const std::exception& e) {
-                    std::lock_guard<std::mutex> lock(error_mutex);
-                    error_messages.push_back("Excepción copiando " + folder + ": " + e.what());
-                    return false;
-                }
-            } else {
-                std::lock_guard<std::mutex> lock(error_mutex);
-                error_messages.push_back("Carpeta no válida: " + folder);
-                return false;
-            }
-        });
-
-    bool all_copied = std::all_of(copy_results.begin(), copy_results.end(), [](bool result) { return result; });
-    
-    if (!all_copied) {
+    if (!error_messages.empty()) {
         std::string combined_errors;
         for (const auto& error : error_messages) {
             combined_errors += error + "\n";
         }
-        show_message("Hubo errores al copiar algunas carpetas:\n" + combined_errors);
+        show_message("Hubo errores con algunas carpetas:\n" + combined_errors);
         return false;
     }
 
-    // Comprimir la carpeta de respaldo completa
-    compress_folder(backup_folder, backup_folder);
-    
-    // Eliminar la carpeta temporal después de crear el ZIP
     try {
-        fs::remove_all(backup_folder);
+        if (fs::exists(zip_path)) {
+            show_message("El archivo de respaldo ya existe. Se sobrescribirá.");
+        }
+        fs::create_directories(destination_folder);
     } catch (const std::exception& e) {
-        std::cerr << "Advertencia: No se pudo eliminar la carpeta temporal: " << e.what() << std::endl;
+        show_message("Error preparando la carpeta de destino: " + std::string(e.what()));
+        return false;
+    }
+
+    // El manifiesto del último respaldo vive junto a los respaldos de la carpeta de destino.
+    fs::path manifest_path = fs::path(destination_folder) / ".backup_tool.manifest";
+    IncrementalState incremental;
+    prepare_incremental(manifest_path, choose_backup_mode(), incremental);
+
+    CodecOptions codec = choose_codec();
+    set_cache_policy(choose_cache_policy());
+    BackupStats stats;
+    if (!compress_folders(folders, zip_path, codec, &stats, &incremental)) {
+        show_message("Error creando el archivo ZIP de respaldo: " + zip_path.string());
+        return false;
     }
+    // Solo se actualizan el manifiesto y las firmas cuando el ZIP quedó completo.
+    commit_incremental(manifest_path, incremental);
 
-    show_message("Respaldo local creado exitosamente: " + backup_name + ".zip");
+    std::cout << describe_stats(stats) << std::endl;
+    show_message("Respaldo local creado exitosamente: " + backup_name + ".zip\n\n" + describe_stats(stats));
     return true;
 }
 
@@ -0,0 +1,98 @@
+#include "MetadataCollector.h"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+
+static constexpr unsigned STATX_FIELDS = STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME | STATX_INO;
+
+static void fill(MetadataRequest& request, const struct statx& st) {
+    request.error = 0;
+    request.size = st.stx_size;
+    request.mode = st.stx_mode;
+    request.mtime_ns = st.stx_mtime.tv_sec * 1000000000LL + st.stx_mtime.tv_nsec;
+    request.inode = st.stx_ino;
+}
+
+static int statx_flags(const MetadataRequest& request) {
+    return request.follow ? 0 : AT_SYMLINK_NOFOLLOW;
+}
+
+MetadataCollector::MetadataCollector() {
+    auto candidate = std::make_unique<IoUring>(METADATA_RING_ENTRIES);
+    if (candidate->valid()) {
+        ring = std::move(candidate);
+        buffers.resize(ring->capacity());
+    }
+}
+
+void MetadataCollector::collect_sync(int dirfd, MetadataRequest& request) {
+    struct statx st;
+    calls++;
+    if (statx(dirfd, request.name, statx_flags(request), STATX_FIELDS, &st) != 0) {
+        request.error = errno;
+        return;
+    }
+    fill(request, st);
+}
+
+// Envía 'count' statx en una sola llamada y espera a todos. Devuelve false si el anillo no
+// sirve (kernel sin IORING_OP_STATX): el lote entero se repite con collect_sync.
+bool MetadataCollector::collect_ring(int dirfd, std::vector<MetadataRequest>& requests, size_t first,
+                                     size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        io_uring_sqe* sqe = ring->get_sqe();
+        MetadataRequest& request = requests[first + i];
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = dirfd;
+        sqe->addr = reinterpret_cast<uint64_t>(request.name);
+        sqe->len = STATX_FIELDS;
+        sqe->off = reinterpret_cast<uint64_t>(&buffers[i]);
+        sqe->statx_flags = statx_flags(request);
+        sqe->user_data = i;
+    }
+    calls++;
+    int submitted = ring->submit(static_cast<unsigned>(count));
+    if (submitted < 0) {
+        return false;
+    }
+
+    bool usable = true;
+    size_t done = 0;
+    while (done < static_cast<size_t>(submitted)) {
+        io_uring_cqe* cqe = ring->peek();
+        if (!cqe) {
+            // submit() solo garantiza las que pidió esperar si se enviaron todas.
+            calls++;
+            if (ring->submit(1) < 0) return false;
+            continue;
+        }
+        size_t i = static_cast<size_t>(cqe->user_data);
+        int res = cqe->res;
+        ring->seen();
+        done++;
+        MetadataRequest& request = requests[first + i];
+        if (res == -EINVAL || res == -EOPNOTSUPP) {
+            usable = false; // La operación no existe en este kernel
+        } else if (res < 0) {
+            request.error = -res;
+        } else {
+            fill(request, buffers[i]);
+        }
+    }
+    return usable && static_cast<size_t>(submitted) == count;
+}
+
+void MetadataCollector::collect(int dirfd, std::vector<MetadataRequest>& requests) {
+    size_t next = 0;
+    while (ring && next < requests.size()) {
+        size_t count = std::min<size_t>(ring->capacity(), requests.size() - next);
+        if (!collect_ring(dirfd, requests, next, count)) {
+            ring.reset(); // A partir de aquí, statx normales
+            break;
+        }
+        next += count;
+    }
+    for (; next < requests.size(); ++next) {
+        collect_sync(dirfd, requests[next]);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef METADATA_COLLECTOR_H
+#define METADATA_COLLECTOR_H
+
+#include "IoUring.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <sys/stat.h>
+
+// Un statx pendiente: 'name' es relativo al directorio que se pasa a collect() y debe seguir
+// válido hasta que vuelva. Al terminar, 'error' es 0 o el errno del statx.
+struct MetadataRequest {
+    const char* name = nullptr;
+    bool follow = false; // Seguir los enlaces simbólicos
+    int error = 0;
+    uint64_t size = 0;
+    uint32_t mode = 0;
+    int64_t mtime_ns = 0;
+    uint64_t inode = 0;
+};
+
+// Tamaño del anillo: statx que van en cada llamada a io_uring_enter.
+constexpr unsigned METADATA_RING_ENTRIES = 256;
+
+// Etapa de metadatos del respaldo: un solo statx por archivo con todo lo que necesitan la
+// planificación del ZIP y la comparación incremental (tipo, modo, tamaño, mtime e inodo).
+// Con io_uring los statx de un lote se envían juntos y cuestan una llamada a io_uring_enter
+// por cada METADATA_RING_ENTRIES archivos; sin io_uring se hace un statx por archivo en el
+// hilo que llama (el recorrido ya reparte los directorios entre los hilos del pool).
+// Cada hilo debe usar su propio MetadataCollector.
+class MetadataCollector {
+public:
+    MetadataCollector();
+
+    void collect(int dirfd, std::vector<MetadataRequest>& requests);
+    bool uses_uring() const { return ring != nullptr; }
+    // Llamadas al sistema hechas hasta ahora (io_uring_enter o statx).
+    uint64_t syscalls() const { return calls; }
+
+private:
+    void collect_sync(int dirfd, MetadataRequest& request);
+    bool collect_ring(int dirfd, std::vector<MetadataRequest>& requests, size_t first, size_t count);
+
+    std::unique_ptr<IoUring> ring;
+    std::vector<struct statx> buffers;
+    uint64_t calls = 0;
+};
+
+#endif // METADATA_COLLECTOR_H
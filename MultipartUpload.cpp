@@ -0,0 +1,369 @@
+#include "MultipartUpload.h"
+#include "Chunker.h" // sha256_hex
+#include "ConnectionPool.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Reintentos de cada parte antes de dar la subida por fallida (queda el diario para retomarla).
+static constexpr int PART_ATTEMPTS = 3;
+
+struct MultipartUpload::Transfer {
+    Part part;
+    CURL* easy = nullptr;
+    curl_slist* headers = nullptr;
+    std::string response;
+    int attempts = 0;
+};
+
+static size_t append_response(void* contents, size_t size, size_t nmemb, void* userp) {
+    static_cast<std::string*>(userp)->append(static_cast<char*>(contents), size * nmemb);
+    return size * nmemb;
+}
+
+static std::string escape(const std::string& text) {
+    char* escaped = curl_easy_escape(nullptr, text.c_str(), static_cast<int>(text.size()));
+    std::string result = escaped ? escaped : "";
+    curl_free(escaped);
+    return result;
+}
+
+// Petición con respuesta JSON a la API. 'response' queda como objeto vacío si el cuerpo no lo es
+// (por ejemplo, la página 404 de Flask cuando el endpoint no existe).
+static bool http_json(const std::string& url, const std::string* post_body, long& status, json& response) {
+    PooledCurl handle;
+    CURL* curl = handle.get();
+    if (!curl) return false;
+    std::string body;
+    curl_slist* headers = curl_slist_append(nullptr, "Content-Type: application/json");
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, append_response);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+    if (post_body) {
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_body->c_str());
+    }
+    CURLcode res = curl_easy_perform(curl);
+    status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_slist_free_all(headers);
+    if (res != CURLE_OK) {
+        std::cerr << "Error de cURL en " << url << ": " << curl_easy_strerror(res) << std::endl;
+        return false;
+    }
+    response = json::parse(body, nullptr, false);
+    if (!response.is_object()) {
+        response = json::object();
+    }
+    return true;
+}
+
+size_t upload_part_size(size_t number) {
+    size_t size = UPLOAD_PART_SIZE;
+    for (size_t step = (number - 1) / UPLOAD_PARTS_PER_SIZE; step > 0 && size < UPLOAD_MAX_PART_SIZE; --step) {
+        size *= 2;
+    }
+    return size;
+}
+
+MultipartUpload::MultipartUpload(const std::string& api_base_url, const fs::path& journal_path)
+    : base_url(api_base_url), journal_path(journal_path), multi(curl_multi_init()) {}
+
+MultipartUpload::~MultipartUpload() {
+    curl_multi_cleanup(multi);
+}
+
+bool MultipartUpload::load_journal() {
+    std::ifstream in(journal_path);
+    std::string line;
+    if (!in || !std::getline(in, line)) {
+        return false;
+    }
+    json header = json::parse(line, nullptr, false);
+    if (!header.is_object() || header.value("part_size", 0ull) != UPLOAD_PART_SIZE) {
+        return false;
+    }
+    upload_id = header.value("upload_id", "");
+    name = header.value("filename", "");
+    journal_parts.clear();
+    while (std::getline(in, line)) {
+        // Una línea cortada por una interrupción simplemente se ignora.
+        json part = json::parse(line, nullptr, false);
+        if (part.is_object() && part.contains("part")) {
+            journal_parts[part["part"].get<size_t>()] = {part.value("size", 0ull), part.value("sha256", ""),
+                                                         part.value("etag", "")};
+        }
+    }
+    return !upload_id.empty() && !name.empty();
+}
+
+void MultipartUpload::append_journal(const std::string& line) {
+    std::ofstream out(journal_path, std::ios::app);
+    out << line << '\n';
+}
+
+std::string MultipartUpload::part_url(size_t number) const {
+    return base_url + "/upload-backup/part?upload_id=" + escape(upload_id) + "&filename=" + escape(name) +
+           "&part=" + std::to_string(number);
+}
+
+bool MultipartUpload::begin(const std::string& filename, std::string& error) {
+    long status = 0;
+    json response;
+    if (load_journal()) {
+        // Retomar: solo valen las partes del diario que el servidor también tiene.
+        std::string url = base_url + "/upload-backup/parts?upload_id=" + escape(upload_id) + "&filename=" + escape(name);
+        if (http_json(url, nullptr, status, response) && status == 200 && response.value("success", false)) {
+            std::map<size_t, std::string> server_parts;
+            for (const auto& part : response["parts"]) {
+                server_parts[part["part"].get<size_t>()] = part["etag"].get<std::string>();
+            }
+            for (auto it = journal_parts.begin(); it != journal_parts.end();) {
+                auto server = server_parts.find(it->first);
+                it = server != server_parts.end() && server->second == it->second.etag ? std::next(it)
+                                                                                       : journal_parts.erase(it);
+            }
+            std::cout << "Retomando la subida de " << name << " (" << journal_parts.size()
+                      << " partes ya enviadas)." << std::endl;
+            return true;
+        }
+        std::cout << "La subida anterior ya no existe en el servidor; se empieza de nuevo." << std::endl;
+        journal_parts.clear();
+    }
+
+    name = filename;
+    std::string body = json{{"filename", name}}.dump();
+    if (!http_json(base_url + "/upload-backup/init", &body, status, response)) {
+        error = "No se pudo conectar con la API Flask.";
+        return false;
+    }
+    if (!response.value("success", false)) {
+        endpoints_missing = status == 404 || status == 405;
+        error = response.value("message", "La API Flask no pudo iniciar la subida (HTTP " + std::to_string(status) + ").");
+        return false;
+    }
+    upload_id = response.value("upload_id", "");
+
+    std::error_code ec;
+    fs::create_directories(journal_path.parent_path(), ec);
+    std::ofstream out(journal_path, std::ios::trunc);
+    out << json{{"upload_id", upload_id}, {"filename", name}, {"part_size", UPLOAD_PART_SIZE}}.dump() << '\n';
+    if (!out) {
+        error = "No se pudo crear el diario de la subida: " + journal_path.string();
+        return false;
+    }
+    return true;
+}
+
+bool MultipartUpload::write(const void* data, size_t len) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    while (len > 0) {
+        if (current.data.empty() && parts_produced == UPLOAD_MAX_PARTS) {
+            // No hay parte 10001: se cancela la compresión en vez de fallar al completar.
+            std::lock_guard<std::mutex> lock(mutex);
+            too_large = true;
+            return false;
+        }
+        size_t part_size = upload_part_size(parts_produced + 1);
+        size_t n = std::min(len, part_size - current.data.size());
+        current.data.insert(current.data.end(), bytes, bytes + n);
+        bytes += n;
+        len -= n;
+        if (current.data.size() == part_size) {
+            push_part();
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    return !cancelled;
+}
+
+void MultipartUpload::push_part() {
+    // El hash se calcula en el hilo del compresor, fuera del bucle de red.
+    current.number = ++parts_produced;
+    current.sha256 = sha256_hex(current.data.data(), current.data.size());
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        // Como mucho UPLOAD_CONCURRENCY partes esperando además de las que están en vuelo.
+        not_full.wait(lock, [&] { return cancelled || ready.size() < UPLOAD_CONCURRENCY; });
+        if (!cancelled) {
+            ready.push_back(std::move(current));
+            not_empty.notify_one();
+        }
+    }
+    current = Part();
+    curl_multi_wakeup(multi);
+}
+
+void MultipartUpload::close(bool ok) {
+    // Un ZIP siempre tiene al menos el final del directorio central, pero por si acaso
+    // una subida vacía lleva una parte vacía.
+    if (ok && (!current.data.empty() || parts_produced == 0)) {
+        push_part();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    producer_closed = true;
+    producer_ok = ok;
+    not_empty.notify_all();
+    curl_multi_wakeup(multi);
+}
+
+bool MultipartUpload::pop_part(Part& part, bool wait) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (wait) {
+        not_empty.wait(lock, [&] { return !ready.empty() || producer_closed || cancelled; });
+    }
+    if (ready.empty()) {
+        return false;
+    }
+    part = std::move(ready.front());
+    ready.pop_front();
+    not_full.notify_one();
+    return true;
+}
+
+bool MultipartUpload::start_transfer(CURLM* multi_handle, Transfer& transfer) {
+    transfer.easy = ConnectionPool::instance().acquire();
+    if (!transfer.easy) return false;
+    transfer.response.clear();
+    transfer.headers = curl_slist_append(nullptr, "Content-Type: application/octet-stream");
+    transfer.headers = curl_slist_append(transfer.headers, ("X-Part-SHA256: " + transfer.part.sha256).c_str());
+    transfer.headers = curl_slist_append(transfer.headers, "Expect:");
+    std::string url = part_url(transfer.part.number);
+    curl_easy_setopt(transfer.easy, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(transfer.easy, CURLOPT_CUSTOMREQUEST, "PUT");
+    curl_easy_setopt(transfer.easy, CURLOPT_POSTFIELDS, transfer.part.data.data());
+    curl_easy_setopt(transfer.easy, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(transfer.part.data.size()));
+    curl_easy_setopt(transfer.easy, CURLOPT_HTTPHEADER, transfer.headers);
+    curl_easy_setopt(transfer.easy, CURLOPT_WRITEFUNCTION, append_response);
+    curl_easy_setopt(transfer.easy, CURLOPT_WRITEDATA, &transfer.response);
+    curl_easy_setopt(transfer.easy, CURLOPT_PRIVATE, &transfer);
+    // Una conexión que se queda colgada cuenta como fallo y la parte se reintenta.
+    curl_easy_setopt(transfer.easy, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(transfer.easy, CURLOPT_LOW_SPEED_TIME, 60L);
+    transfer.attempts++;
+    return curl_multi_add_handle(multi_handle, transfer.easy) == CURLM_OK;
+}
+
+bool MultipartUpload::run(std::string& error) {
+    std::map<size_t, std::string> etags;
+    std::vector<std::unique_ptr<Transfer>> active;
+    size_t skipped = 0;
+    bool failed = false;
+
+    auto finish_transfer = [&](Transfer& transfer) {
+        curl_multi_remove_handle(multi, transfer.easy);
+        ConnectionPool::instance().release(transfer.easy);
+        curl_slist_free_all(transfer.headers);
+        transfer.easy = nullptr;
+        transfer.headers = nullptr;
+    };
+
+    while (!failed) {
+        // Llenar los huecos libres con las partes que ya generó el compresor. Solo se espera
+        // a la siguiente parte si no hay ninguna transferencia en curso.
+        while (active.size() < UPLOAD_CONCURRENCY) {
+            Part part;
+            if (!pop_part(part, active.empty())) break;
+            auto done = journal_parts.find(part.number);
+            if (done != journal_parts.end() && done->second.size == part.data.size() &&
+                done->second.sha256 == part.sha256) {
+                etags[part.number] = done->second.etag; // Ya está en el servidor
+                ++skipped;
+                continue;
+            }
+            auto transfer = std::make_unique<Transfer>();
+            transfer->part = std::move(part);
+            if (!start_transfer(multi, *transfer)) {
+                error = "No se pudo iniciar la subida de una parte.";
+                failed = true;
+                break;
+            }
+            active.push_back(std::move(transfer));
+        }
+        if (failed) break;
+        if (active.empty()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (producer_closed && ready.empty()) break;
+            continue;
+        }
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+        int left = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &left)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            Transfer* transfer = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, reinterpret_cast<char**>(&transfer));
+            long status = 0;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &status);
+            CURLcode result = msg->data.result;
+            finish_transfer(*transfer);
+
+            json response = json::parse(transfer->response, nullptr, false);
+            bool ok = result == CURLE_OK && status == 200 && response.is_object() &&
+                      response.value("success", false) && response.contains("etag");
+            const Part& part = transfer->part;
+            if (ok) {
+                etags[part.number] = response["etag"].get<std::string>();
+                append_journal(json{{"part", part.number}, {"size", part.data.size()},
+                                    {"sha256", part.sha256}, {"etag", etags[part.number]}}.dump());
+                active.erase(std::find_if(active.begin(), active.end(),
+                                          [&](const auto& t) { return t.get() == transfer; }));
+            } else if (transfer->attempts < PART_ATTEMPTS) {
+                std::cerr << "Reintentando la parte " << part.number << " ("
+                          << (result != CURLE_OK ? curl_easy_strerror(result) : "HTTP " + std::to_string(status))
+                          << ")" << std::endl;
+                if (!start_transfer(multi, *transfer)) failed = true;
+            } else {
+                error = "La parte " + std::to_string(part.number) + " no se pudo subir tras " +
+                        std::to_string(PART_ATTEMPTS) + " intentos.";
+                failed = true;
+            }
+        }
+        if (!failed && !active.empty()) {
+            curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        }
+    }
+
+    for (auto& transfer : active) {
+        if (transfer->easy) finish_transfer(*transfer);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = failed; // Desbloquea al compresor si todavía está produciendo
+        not_full.notify_all();
+        if (!failed && too_large) {
+            error = "El respaldo supera el máximo de " + std::to_string(UPLOAD_MAX_PARTS) +
+                    " partes de una subida multiparte (unos 984 GB); la subida se canceló.";
+            failed = true;
+        } else if (!failed && !producer_ok) {
+            error = "El archivo ZIP no se generó correctamente; la subida se canceló.";
+            failed = true;
+        }
+    }
+    if (failed) {
+        return false;
+    }
+
+    json parts = json::array();
+    for (size_t number = 1; number <= parts_produced; ++number) {
+        parts.push_back({{"part", number}, {"etag", etags[number]}});
+    }
+    std::string body = json{{"upload_id", upload_id}, {"filename", name}, {"parts", parts}}.dump();
+    long status = 0;
+    json response;
+    if (!http_json(base_url + "/upload-backup/complete", &body, status, response) || !response.value("success", false)) {
+        error = response.value("message", "La API Flask no pudo completar la subida.");
+        return false;
+    }
+    if (skipped > 0) {
+        std::cout << skipped << " de " << parts_produced << " partes ya estaban subidas y no se reenviaron." << std::endl;
+    }
+    std::error_code ec;
+    fs::remove(journal_path, ec);
+    return true;
+}
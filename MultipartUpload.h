@@ -0,0 +1,99 @@
+#ifndef MULTIPART_UPLOAD_H
+#define MULTIPART_UPLOAD_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <curl/curl.h>
+
+namespace fs = std::filesystem;
+
+// Tamaño de las partes y cuántas se suben a la vez. S3 exige partes de al menos 5 MB (salvo
+// la última) y como mucho 10000 partes. Con partes fijas de 16 MB el límite sería de unos
+// 156 GB, así que las partes crecen: 16 MB las primeras 1000 y el doble cada 1000 más, hasta
+// 128 MB (en total unos 984 GB). S3 admite partes de distinto tamaño en la misma subida.
+constexpr size_t UPLOAD_PART_SIZE = 16 * 1024 * 1024;
+constexpr size_t UPLOAD_MAX_PART_SIZE = 128 * 1024 * 1024;
+constexpr size_t UPLOAD_PARTS_PER_SIZE = 1000;
+constexpr size_t UPLOAD_MAX_PARTS = 10000;
+constexpr size_t UPLOAD_CONCURRENCY = 4;
+
+// Tamaño de la parte 'number' (desde 1). Solo depende del número, así que una subida retomada
+// vuelve a cortar el ZIP por los mismos sitios y puede comparar las partes con el diario.
+size_t upload_part_size(size_t number);
+
+// Subida multiparte reanudable a la API Flask (/upload-backup/init, /part, /parts y /complete).
+// El ZIP se corta en partes (ver upload_part_size) a medida que se genera y varias partes viajan en
+// paralelo sobre un curl multi. Cada parte confirmada queda en un diario local con su SHA-256
+// y su ETag: si la subida se interrumpe, la siguiente ejecución vuelve a generar el ZIP y solo
+// envía las partes cuyo contenido no coincide con el diario.
+class MultipartUpload {
+public:
+    MultipartUpload(const std::string& api_base_url, const fs::path& journal_path);
+    ~MultipartUpload();
+    MultipartUpload(const MultipartUpload&) = delete;
+    MultipartUpload& operator=(const MultipartUpload&) = delete;
+
+    // Empieza la subida de 'filename' o retoma la que está en el diario (en ese caso
+    // filename() devuelve el nombre original). Si falla, unsupported() indica si es porque
+    // el servidor no tiene los endpoints multiparte.
+    bool begin(const std::string& filename, std::string& error);
+    bool unsupported() const { return endpoints_missing; }
+    const std::string& filename() const { return name; }
+    size_t resumed_parts() const { return journal_parts.size(); }
+
+    // Lado del productor (hilo del compresor): se usa como ZipSink.
+    bool write(const void* data, size_t len);
+    void close(bool ok);
+
+    // Sube las partes a medida que llegan y completa la subida. Devuelve true si el servidor
+    // confirmó el archivo; en ese caso se borra el diario.
+    bool run(std::string& error);
+
+private:
+    struct Part {
+        size_t number = 0; // Desde 1, como en S3
+        std::vector<unsigned char> data;
+        std::string sha256;
+    };
+    struct JournalPart {
+        size_t size;
+        std::string sha256;
+        std::string etag;
+    };
+    struct Transfer;
+
+    void push_part();
+    bool pop_part(Part& part, bool wait);
+    bool start_transfer(CURLM* multi, Transfer& transfer);
+    bool load_journal();
+    void append_journal(const std::string& line);
+    std::string part_url(size_t number) const;
+
+    std::string base_url;
+    fs::path journal_path;
+    std::string upload_id;
+    std::string name;
+    bool endpoints_missing = false;
+    std::map<size_t, JournalPart> journal_parts;
+
+    // Cola de partes entre el compresor y el bucle de subida
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::deque<Part> ready;
+    Part current;
+    size_t parts_produced = 0;
+    bool producer_closed = false;
+    bool producer_ok = true;
+    bool too_large = false; // El ZIP no cabe en UPLOAD_MAX_PARTS partes
+    bool cancelled = false;
+    CURLM* multi = nullptr;
+};
+
+#endif // MULTIPART_UPLOAD_H
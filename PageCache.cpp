@@ -0,0 +1,135 @@
+#include "PageCache.h"
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static std::atomic<CachePolicy> current_policy{CachePolicy::DropBehind};
+
+const char* cache_policy_name(CachePolicy policy) {
+    switch (policy) {
+        case CachePolicy::Normal: return "normal";
+        case CachePolicy::DropBehind: return "liberar";
+        case CachePolicy::Direct: return "directa";
+    }
+    return "?";
+}
+
+bool cache_policy_from_name(const std::string& name, CachePolicy& policy) {
+    for (CachePolicy candidate : {CachePolicy::Normal, CachePolicy::DropBehind, CachePolicy::Direct}) {
+        if (name == cache_policy_name(candidate)) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void set_cache_policy(CachePolicy policy) {
+    current_policy.store(policy, std::memory_order_relaxed);
+}
+
+CachePolicy cache_policy() {
+    return current_policy.load(std::memory_order_relaxed);
+}
+
+// Los consejos son solo eso: si el sistema de archivos no los admite no pasa nada.
+void advise_sequential(int fd, uint64_t offset, uint64_t length) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_WILLNEED);
+}
+
+void drop_read_pages(int fd, uint64_t offset, uint64_t length) {
+    posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_DONTNEED);
+}
+
+void WriteBehind::written(uint64_t offset, uint64_t length) {
+    // Las páginas sucias no se pueden soltar: primero se empieza a escribir la ventana nueva y
+    // luego se espera a la anterior (que ya lleva una ventana de ventaja) antes del DONTNEED.
+    sync_file_range(fd, static_cast<off_t>(offset), static_cast<off_t>(length), SYNC_FILE_RANGE_WRITE);
+    if (pending_length > 0) {
+        sync_file_range(fd, static_cast<off_t>(pending_offset), static_cast<off_t>(pending_length),
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(fd, static_cast<off_t>(pending_offset), static_cast<off_t>(pending_length),
+                      POSIX_FADV_DONTNEED);
+    }
+    pending_offset = offset;
+    pending_length = length;
+}
+
+void WriteBehind::finish() {
+    if (pending_length == 0) return;
+    // La última ventana no se espera (cada archivo pequeño esperaría al disco): el DONTNEED
+    // suelta lo que ya esté escrito y el resto queda para cuando lo escriba el kernel.
+    posix_fadvise(fd, static_cast<off_t>(pending_offset), static_cast<off_t>(pending_length), POSIX_FADV_DONTNEED);
+    pending_length = 0;
+}
+
+// Páginas residentes de 'path', un byte por página. Devuelve false si no se pudo medir.
+static bool resident_pages(const fs::path& path, std::vector<unsigned char>& resident) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    size_t length = static_cast<size_t>(st.st_size);
+    // El mapeo no trae páginas: mincore solo mira las que ya están en la caché.
+    void* map = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    resident.assign((length + page - 1) / page, 0);
+    bool ok = mincore(map, length, resident.data()) == 0;
+    munmap(map, length);
+    return ok;
+}
+
+void CacheSampler::before_read(const fs::path& path, size_t n) {
+    if (n % CACHE_SAMPLE_EVERY != 0) return;
+    Sample sample{path, {}};
+    if (!resident_pages(path, sample.resident)) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    samples.push_back(std::move(sample));
+}
+
+void CacheSampler::finish(CacheUsage& usage) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<unsigned char> after;
+    for (const Sample& sample : samples) {
+        if (!resident_pages(sample.path, after)) continue;
+        size_t pages = std::min(after.size(), sample.resident.size());
+        usage.files++;
+        usage.pages += pages;
+        for (size_t p = 0; p < pages; ++p) {
+            bool was = sample.resident[p] & 1;
+            bool is = after[p] & 1;
+            usage.resident_before += was;
+            usage.resident_after += is;
+            usage.added += is && !was;
+            usage.evicted += was && !is;
+        }
+    }
+    samples.clear();
+}
+
+std::string describe_cache_usage(const CacheUsage& usage) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    double page_mb = sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+    out << "Caché de páginas (" << cache_policy_name(cache_policy()) << "): muestra de " << usage.files
+        << " archivos, " << usage.pages * page_mb << " MB; residentes " << usage.resident_before * page_mb
+        << " MB antes y " << usage.resident_after * page_mb << " MB después (";
+    if (usage.pages > 0) {
+        out << 100.0 * usage.added / usage.pages << "% añadido";
+    } else {
+        out << "sin datos";
+    }
+    out << ", " << usage.evicted * page_mb << " MB soltados)";
+    return out.str();
+}
@@ -0,0 +1,89 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Cómo usan la caché de páginas las lecturas de los archivos de origen (compresión y copia).
+// Un respaldo completo lee todo el servidor una vez: si esas páginas se quedan en la caché
+// expulsan las de los servicios que corren en la misma máquina.
+enum class CachePolicy {
+    Normal,     // Lecturas normales: lo leído queda en la caché
+    DropBehind, // Lectura secuencial por adelantado y POSIX_FADV_DONTNEED de lo ya consumido
+    Direct      // O_DIRECT con buffers alineados (sin pasar por la caché) donde se admita
+};
+const char* cache_policy_name(CachePolicy policy);
+bool cache_policy_from_name(const std::string& name, CachePolicy& policy);
+
+// Política de todo el proceso (por defecto DropBehind); se elige una vez antes del respaldo.
+void set_cache_policy(CachePolicy policy);
+CachePolicy cache_policy();
+
+// Con O_DIRECT el buffer, la posición y la longitud de cada lectura van alineados a esto.
+constexpr size_t DIRECT_IO_ALIGNMENT = 4096;
+inline size_t direct_io_length(size_t length) {
+    return (length + DIRECT_IO_ALIGNMENT - 1) & ~(DIRECT_IO_ALIGNMENT - 1);
+}
+
+// Ventana de las lecturas y escrituras por trozos con DropBehind: se pide por adelantado la
+// siguiente y se suelta la anterior.
+constexpr uint64_t CACHE_WINDOW_SIZE = 8ull << 20;
+
+// 'fd' se va a leer de seguido desde 'offset': duplica la lectura por adelantado del kernel
+// (SEQUENTIAL) y empieza a traer los próximos 'length' bytes (WILLNEED).
+void advise_sequential(int fd, uint64_t offset, uint64_t length);
+// Suelta de la caché las páginas ya leídas.
+void drop_read_pages(int fd, uint64_t offset, uint64_t length);
+
+// Escritura secuencial que no deja la caché llena de páginas sucias: cada ventana escrita se
+// manda a disco sin esperar y la anterior, ya escrita, se suelta de la caché.
+class WriteBehind {
+public:
+    explicit WriteBehind(int fd) : fd(fd) {}
+    void written(uint64_t offset, uint64_t length);
+    void finish();
+
+private:
+    int fd;
+    uint64_t pending_offset = 0;
+    uint64_t pending_length = 0;
+};
+
+// Métrica de contaminación de la caché: páginas residentes (mincore) de una muestra de los
+// archivos leídos, antes de leerlos y al terminar.
+struct CacheUsage {
+    uint64_t files = 0;
+    uint64_t pages = 0;
+    uint64_t resident_before = 0;
+    uint64_t resident_after = 0;
+    uint64_t added = 0;   // Páginas que la lectura dejó en la caché
+    uint64_t evicted = 0; // Páginas que estaban y ya no (DONTNEED o presión de memoria)
+};
+std::string describe_cache_usage(const CacheUsage& usage);
+
+// Se mide uno de cada CACHE_SAMPLE_EVERY archivos: mmap + mincore + munmap por archivo.
+constexpr size_t CACHE_SAMPLE_EVERY = 16;
+
+class CacheSampler {
+public:
+    // Mide 'path' antes de leerlo si le toca muestra (el n-ésimo archivo, contando desde 0).
+    void before_read(const fs::path& path, size_t n);
+    // Vuelve a medir los archivos de la muestra y acumula el resultado en 'usage'.
+    void finish(CacheUsage& usage);
+
+private:
+    struct Sample {
+        fs::path path;
+        std::vector<unsigned char> resident; // Un byte por página (bit 0: residente)
+    };
+    std::mutex mutex;
+    std::vector<Sample> samples;
+};
+
+#endif // PAGE_CACHE_H
@@ -0,0 +1,60 @@
+#include "Pipeline.h"
+#include "SystemLimits.h"
+#include <cstdlib>
+
+static constexpr uint64_t DEFAULT_MEMORY_BUDGET = 512ull << 20;
+
+static uint64_t default_memory_budget() {
+    if (const char* env = std::getenv("BACKUP_TOOL_MEMORY_MB")) {
+        long long mb = std::atoll(env);
+        if (mb > 0) return static_cast<uint64_t>(mb) << 20;
+    }
+    uint64_t memory = system_limits().usable_memory();
+    if (memory == 0) return DEFAULT_MEMORY_BUDGET;
+    return std::min(DEFAULT_MEMORY_BUDGET, memory / 4);
+}
+
+static std::atomic<uint64_t> budget_override{0};
+
+uint64_t memory_budget() {
+    uint64_t bytes = budget_override.load(std::memory_order_relaxed);
+    if (bytes > 0) return bytes;
+    static const uint64_t fallback = default_memory_budget();
+    return fallback;
+}
+
+void set_memory_budget(uint64_t bytes) {
+    budget_override.store(bytes, std::memory_order_relaxed);
+}
+
+unsigned pipeline_buffer_count(uint64_t budget) {
+    return static_cast<unsigned>(std::max<uint64_t>(2, budget / (2 * PIPELINE_BUFFER_SIZE)));
+}
+
+BufferPool::BufferPool(unsigned count) : free_list(count) {
+    for (unsigned i = 0; i < count; ++i) {
+        free_list.try_push(i);
+    }
+}
+
+bool BufferPool::acquire(unsigned& index) {
+    if (closed.load()) return false;
+    if (!free_list.try_pop(index)) {
+        wait_count.fetch_add(1, std::memory_order_relaxed);
+        if (!free_list.pop(index)) return false;
+    }
+    return !closed.load();
+}
+
+void BufferPool::release(unsigned index) {
+    free_list.push(index);
+}
+
+void BufferPool::close() {
+    closed.store(true);
+    free_list.close();
+}
+
+uint64_t BufferPool::waits() {
+    return wait_count.load(std::memory_order_relaxed);
+}
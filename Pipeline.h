@@ -0,0 +1,232 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Piezas del pipeline del respaldo (recorrido -> lectura -> compresión -> escritura/subida):
+// colas acotadas sin locks entre etapas y un pool de buffers grandes que se reciclan. La memoria de los
+// datos en vuelo la fija el presupuesto, no el tamaño del árbol.
+
+// Tamaño de cada buffer del pool: cabe la unidad más grande del compresor (un archivo entero
+// de hasta 4 MB o un bloque de 1 MB con su diccionario), alineada para O_DIRECT.
+constexpr uint64_t PIPELINE_BUFFER_SIZE = 8ull << 20;
+
+// Presupuesto de memoria para los datos en vuelo. Por defecto la variable de entorno
+// BACKUP_TOOL_MEMORY_MB o, si no está, la cuarta parte de la memoria utilizable (la RAM o el
+// límite del cgroup si es menor) con un máximo de 512 MB.
+uint64_t memory_budget();
+void set_memory_budget(uint64_t bytes);
+// Buffers del pool que caben en el presupuesto si cada uno puede tener a la vez sus datos
+// leídos y los comprimidos (como mínimo dos, para que lectura y compresión se solapen).
+unsigned pipeline_buffer_count(uint64_t budget);
+
+// Ocupación de una cola a lo largo del respaldo.
+struct QueueStats {
+    size_t capacity = 0;
+    size_t max_depth = 0;
+    uint64_t pushes = 0;
+    uint64_t depth_sum = 0; // Suma de la profundidad tras cada push
+    double average() const { return pushes ? static_cast<double>(depth_sum) / pushes : 0.0; }
+};
+
+// Cola FIFO acotada entre etapas, sin locks para varios productores y consumidores (el anillo
+// de Dmitry Vyukov): cada celda lleva un número de secuencia que dice si está libre para el
+// productor de esa vuelta o llena para su consumidor, así que push y pop son un CAS sobre su
+// posición y nadie toma un mutex mientras haya sitio y datos. Solo quien tiene que esperar
+// (cola llena o vacía) duerme en una variable de condición tras unos reintentos.
+// push() espera si está llena; pop() espera si está vacía y devuelve false cuando la cola se
+// cerró y ya no queda nada. La capacidad se redondea a la siguiente potencia de dos.
+template <typename T>
+class MpmcQueue {
+public:
+    explicit MpmcQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        mask = size - 1;
+        cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_push(T& value) {
+        if (!push_once(value)) return false;
+        wake_waiters();
+        return true;
+    }
+
+    bool try_pop(T& out) {
+        if (!pop_once(out)) return false;
+        wake_waiters();
+        return true;
+    }
+
+    bool push(T value) {
+        return wait_for([&] { return push_once(value); }, false);
+    }
+
+    bool pop(T& out) {
+        return wait_for([&] { return pop_once(out); }, true);
+    }
+
+    // No habrá más push(); los consumidores terminan de vaciar la cola.
+    void close() {
+        closed.store(true);
+        std::lock_guard<std::mutex> lock(mutex);
+        changed.notify_all();
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    QueueStats statistics() const {
+        QueueStats stats;
+        stats.capacity = capacity();
+        stats.max_depth = max_depth.load(std::memory_order_relaxed);
+        stats.pushes = pushes.load(std::memory_order_relaxed);
+        stats.depth_sum = depth_sum.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+    // Reintentos (cediendo el hilo) antes de dormir: la otra etapa suele estar a punto.
+    static constexpr unsigned SPIN_TRIES = 64;
+
+    // Operaciones sobre el anillo sin avisar a los que esperan: el aviso lo da quien las llama,
+    // según tenga o no el mutex tomado.
+    bool push_once(T& value) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false; // Llena: la celda aún tiene el dato de la vuelta anterior
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        // Con varios productores, los consumidores pueden haber sacado ya este dato y los de
+        // otros productores antes de leer dequeue_pos: la diferencia puede salir negativa.
+        intptr_t depth = static_cast<intptr_t>(pos + 1 - dequeue_pos.load(std::memory_order_relaxed));
+        record_depth(static_cast<size_t>(std::clamp<intptr_t>(depth, 0, static_cast<intptr_t>(capacity()))));
+        return true;
+    }
+
+    bool pop_once(T& out) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false; // Vacía
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(cell->value);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release); // Libre para la vuelta siguiente
+        return true;
+    }
+
+    // Repite 'attempt' hasta que salga bien o la cola se cierre. Un consumidor aún vacía lo
+    // que quede tras el cierre; un productor se rinde en cuanto se cierra.
+    template <typename Attempt>
+    bool wait_for(Attempt attempt, bool consumer) {
+        for (unsigned tries = 0;; ++tries) {
+            bool was_closed = closed.load();
+            if (!consumer && was_closed) return false;
+            if (attempt()) {
+                wake_waiters();
+                return true;
+            }
+            if (was_closed) return false;
+            if (tries < SPIN_TRIES) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            // Se anota antes de reintentar: quien complete una operación después ve que hay
+            // alguien esperando y avisa con el mutex tomado, así que el aviso no se pierde.
+            waiters.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (attempt()) {
+                // El mutex ya es nuestro (no es recursivo): se avisa aquí en vez de con wake_waiters().
+                waiters.fetch_sub(1);
+                changed.notify_all();
+                return true;
+            }
+            if (!closed.load()) changed.wait(lock);
+            waiters.fetch_sub(1);
+        }
+    }
+
+    void wake_waiters() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load() == 0) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        changed.notify_all();
+    }
+
+    void record_depth(size_t depth) {
+        pushes.fetch_add(1, std::memory_order_relaxed);
+        depth_sum.fetch_add(depth, std::memory_order_relaxed);
+        size_t seen = max_depth.load(std::memory_order_relaxed);
+        while (depth > seen && !max_depth.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {
+        }
+    }
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    // Cada posición en su línea de caché: productores y consumidores no se estorban.
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) std::atomic<size_t> dequeue_pos{0};
+    alignas(64) std::atomic<unsigned> waiters{0};
+    std::atomic<bool> closed{false};
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::atomic<uint64_t> pushes{0};
+    std::atomic<uint64_t> depth_sum{0};
+    std::atomic<size_t> max_depth{0};
+};
+
+// Pool de los índices de 'count' buffers (los del IoEngine de la lectura, ya registrados en el
+// kernel). Quien produce datos espera aquí a que se libere un buffer: esa es la contrapresión
+// que frena la lectura cuando la compresión o la escritura van más lentas.
+class BufferPool {
+public:
+    explicit BufferPool(unsigned count);
+
+    // Devuelve false si el pool se cerró (el pipeline se está deteniendo).
+    bool acquire(unsigned& index);
+    void release(unsigned index);
+    void close();
+    // Veces que acquire() tuvo que esperar.
+    uint64_t waits();
+
+private:
+    MpmcQueue<unsigned> free_list;
+    std::atomic<bool> closed{false};
+    std::atomic<uint64_t> wait_count{0};
+};
+
+#endif // PIPELINE_H
@@ -0,0 +1,246 @@
+#include "RangedDownload.h"
+#include "ConnectionPool.h"
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <curl/curl.h>
+
+// Reintentos de cada rango antes de dar la descarga por fallida.
+static constexpr int RANGE_ATTEMPTS = 3;
+
+struct RangedDownloader::Range {
+    size_t index = 0;
+    curl_off_t offset = 0;
+    curl_off_t length = 0;
+    curl_off_t received = 0; // Bytes ya recibidos
+    int attempts = 0;
+    bool partial = true;     // false: petición sin cabecera Range (el servidor no acepta rangos)
+    bool done = false;
+    std::vector<unsigned char> buffer; // En orden: lo que llegó antes de que le toque entregarse
+    Job* job = nullptr;
+    CURL* easy = nullptr;
+};
+
+// Una descarga: sus rangos y el sink que recibe los bytes en orden.
+struct RangedDownloader::Job {
+    const DownloadSink* sink = nullptr;
+    std::vector<std::unique_ptr<Range>> ranges;
+    size_t head = 0; // Primer rango todavía no entregado por completo al sink
+    bool sink_failed = false;
+};
+
+// Pasa lo recibido al sink, o lo guarda si el rango aún no es el siguiente. Si el servidor ignoró
+// la cabecera Range (responde 200 con el archivo entero) o manda más bytes de los pedidos,
+// se aborta.
+size_t RangedDownloader::write_range(char* data, size_t size, size_t nmemb, void* userp) {
+    Range* range = static_cast<Range*>(userp);
+    Job& job = *range->job;
+    size_t len = size * nmemb;
+    if (range->partial) {
+        long status = 0;
+        curl_easy_getinfo(range->easy, CURLINFO_RESPONSE_CODE, &status);
+        if (status != 206) return 0;
+    }
+    if (range->received + static_cast<curl_off_t>(len) > range->length) return 0;
+    if (range->index != job.head) {
+        range->buffer.insert(range->buffer.end(), data, data + len);
+    } else if (!(*job.sink)(data, len)) {
+        job.sink_failed = true;
+        return 0;
+    }
+    range->received += static_cast<curl_off_t>(len);
+    return len;
+}
+
+// Entrega al sink los rangos que ya pueden ir en orden: lo guardado del primero pendiente y
+// los siguientes que hayan terminado.
+bool RangedDownloader::deliver(Job& job) {
+    while (job.head < job.ranges.size()) {
+        Range& range = *job.ranges[job.head];
+        if (!range.buffer.empty()) {
+            if (!(*job.sink)(range.buffer.data(), range.buffer.size())) {
+                job.sink_failed = true;
+                return false;
+            }
+            std::vector<unsigned char>().swap(range.buffer);
+        }
+        if (!range.done) break;
+        job.head++;
+    }
+    return true;
+}
+
+namespace {
+
+size_t check_accept_ranges(char* buffer, size_t size, size_t nitems, void* userp) {
+    std::string line(buffer, size * nitems);
+    std::transform(line.begin(), line.end(), line.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (line.rfind("accept-ranges:", 0) == 0 && line.find("bytes") != std::string::npos) {
+        *static_cast<bool*>(userp) = true;
+    }
+    return size * nitems;
+}
+
+} // namespace
+
+RangedDownloader::RangedDownloader() : multi(curl_multi_init()) {}
+
+RangedDownloader::~RangedDownloader() {
+    curl_multi_cleanup(multi);
+}
+
+bool RangedDownloader::probe(const std::string& url, curl_off_t& size, bool& accepts_ranges, std::string& error) {
+    PooledCurl handle;
+    CURL* curl = handle.get();
+    if (!curl) {
+        error = "No se pudo inicializar cURL.";
+        return false;
+    }
+    accepts_ranges = false;
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, check_accept_ranges);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &accepts_ranges);
+    CURLcode res = curl_easy_perform(curl);
+    long status = 0;
+    size = -1;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &size);
+    if (res != CURLE_OK) {
+        error = curl_easy_strerror(res);
+        return false;
+    }
+    if (status != 200) {
+        error = status == 404 ? "el respaldo no existe en el servidor" : "HTTP " + std::to_string(status);
+        return false;
+    }
+    return true;
+}
+
+bool RangedDownloader::start_range(const std::string& url, Range& range) {
+    range.easy = ConnectionPool::instance().acquire();
+    if (!range.easy) return false;
+    curl_easy_setopt(range.easy, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(range.easy, CURLOPT_WRITEFUNCTION, write_range);
+    curl_easy_setopt(range.easy, CURLOPT_WRITEDATA, &range);
+    curl_easy_setopt(range.easy, CURLOPT_PRIVATE, &range);
+    if (range.partial) {
+        // Un reintento pide solo lo que falta del rango.
+        std::string bytes = std::to_string(range.offset + range.received) + "-" +
+                            std::to_string(range.offset + range.length - 1);
+        curl_easy_setopt(range.easy, CURLOPT_RANGE, bytes.c_str());
+    }
+    // Una conexión que se queda colgada cuenta como fallo y el rango se reintenta.
+    curl_easy_setopt(range.easy, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(range.easy, CURLOPT_LOW_SPEED_TIME, 60L);
+    range.attempts++;
+    return curl_multi_add_handle(multi, range.easy) == CURLM_OK;
+}
+
+bool RangedDownloader::download(const std::string& url, const DownloadSink& sink, std::string& error) {
+    curl_off_t size = 0;
+    bool accepts_ranges = false;
+    if (!probe(url, size, accepts_ranges, error)) {
+        return false;
+    }
+    Job job;
+    job.sink = &sink;
+    bool ok = transfer(url, size, accepts_ranges, job, error);
+    if (job.sink_failed) {
+        error = "la descarga se canceló";
+    }
+    return ok;
+}
+
+bool RangedDownloader::transfer(const std::string& url, curl_off_t size, bool accepts_ranges, Job& job,
+                                std::string& error) {
+    if (size < 0 || !accepts_ranges) {
+        // Sin tamaño conocido o sin rangos: una sola petición de todo el archivo.
+        auto range = std::make_unique<Range>();
+        range->length = size < 0 ? INT64_MAX : size;
+        range->partial = false;
+        job.ranges.push_back(std::move(range));
+    } else {
+        for (curl_off_t offset = 0; offset < size; offset += DOWNLOAD_RANGE_SIZE) {
+            auto range = std::make_unique<Range>();
+            range->offset = offset;
+            range->length = std::min<curl_off_t>(DOWNLOAD_RANGE_SIZE, size - offset);
+            job.ranges.push_back(std::move(range));
+        }
+    }
+    std::deque<Range*> pending;
+    for (size_t i = 0; i < job.ranges.size(); ++i) {
+        job.ranges[i]->index = i;
+        job.ranges[i]->job = &job;
+        pending.push_back(job.ranges[i].get());
+    }
+
+    size_t active = 0;
+    bool failed = multi == nullptr;
+    if (failed) error = "No se pudo inicializar cURL.";
+    while (!failed && (active > 0 || !pending.empty())) {
+        // No se adelantan más de DOWNLOAD_WINDOW rangos al primero pendiente de entregar.
+        while (active < DOWNLOAD_CONCURRENCY && !pending.empty() &&
+               pending.front()->index < job.head + DOWNLOAD_WINDOW) {
+            if (!start_range(url, *pending.front())) {
+                error = "No se pudo iniciar la descarga de un rango.";
+                failed = true;
+                break;
+            }
+            pending.pop_front();
+            ++active;
+        }
+        if (failed) break;
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+        int left = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &left)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            Range* range = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, reinterpret_cast<char**>(&range));
+            long status = 0;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &status);
+            CURLcode result = msg->data.result;
+            curl_multi_remove_handle(multi, range->easy);
+            ConnectionPool::instance().release(range->easy);
+            range->easy = nullptr;
+            --active;
+
+            bool complete = range->partial ? range->received == range->length : size < 0 || range->received == size;
+            if (result == CURLE_OK && status == (range->partial ? 206 : 200) && complete) {
+                range->done = true;
+                if (!deliver(job)) {
+                    failed = true;
+                }
+                continue;
+            }
+            if (job.sink_failed) {
+                failed = true;
+            } else if (range->partial && range->attempts < RANGE_ATTEMPTS) {
+                std::cerr << "Reintentando el rango desde el byte " << range->offset + range->received << " ("
+                          << (result != CURLE_OK ? curl_easy_strerror(result) : "HTTP " + std::to_string(status))
+                          << ")" << std::endl;
+                pending.push_front(range); // Va antes que los rangos que aún no empezaron
+            } else {
+                error = result != CURLE_OK ? curl_easy_strerror(result)
+                                           : "respuesta incompleta del servidor (HTTP " + std::to_string(status) + ")";
+                failed = true;
+            }
+        }
+        if (!failed && active > 0) {
+            curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        }
+    }
+
+    for (auto& range : job.ranges) {
+        if (range->easy) {
+            curl_multi_remove_handle(multi, range->easy);
+            ConnectionPool::instance().release(range->easy);
+        }
+    }
+    return !failed;
+}
@@ -0,0 +1,49 @@
+#ifndef RANGED_DOWNLOAD_H
+#define RANGED_DOWNLOAD_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <curl/curl.h>
+
+// Tamaño de cada rango y cuántos se descargan a la vez. Con un solo stream TCP la descarga
+// queda limitada por la ventana de la conexión; varios rangos en paralelo llenan el enlace.
+constexpr size_t DOWNLOAD_RANGE_SIZE = 8 * 1024 * 1024;
+constexpr size_t DOWNLOAD_CONCURRENCY = 4;
+// Al entregar en orden, rangos que pueden descargarse por delante del primero pendiente
+// (lo que llega antes de tiempo se guarda en memoria: como mucho unos 64 MB).
+constexpr size_t DOWNLOAD_WINDOW = 2 * DOWNLOAD_CONCURRENCY;
+
+// Recibe los bytes descargados en orden; devuelve false para cancelar la descarga.
+using DownloadSink = std::function<bool(const void* data, size_t len)>;
+
+// Descargador por rangos de bytes en paralelo (curl multi). Los handles salen del
+// ConnectionPool, así que los rangos reutilizan las conexiones abiertas. El curl multi es
+// propio: cada hilo que descarga debe tener su RangedDownloader.
+class RangedDownloader {
+public:
+    RangedDownloader();
+    ~RangedDownloader();
+    RangedDownloader(const RangedDownloader&) = delete;
+    RangedDownloader& operator=(const RangedDownloader&) = delete;
+
+    // Descarga 'url' y entrega los bytes en orden a 'sink'. Primero pide la cabecera (HEAD)
+    // para conocer el tamaño; los rangos que llegan antes que los anteriores esperan en
+    // memoria. Si el servidor no acepta rangos se descarga con una sola petición. Cada rango
+    // se reintenta desde el último byte recibido. Si falla, 'error' explica el motivo.
+    bool download(const std::string& url, const DownloadSink& sink, std::string& error);
+
+private:
+    struct Range;
+    struct Job;
+
+    bool probe(const std::string& url, curl_off_t& size, bool& accepts_ranges, std::string& error);
+    bool start_range(const std::string& url, Range& range);
+    bool transfer(const std::string& url, curl_off_t size, bool accepts_ranges, Job& job, std::string& error);
+    static bool deliver(Job& job);
+    static size_t write_range(char* data, size_t size, size_t nmemb, void* userp);
+
+    CURLM* multi;
+};
+
+#endif // RANGED_DOWNLOAD_H
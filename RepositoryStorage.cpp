@@ -0,0 +1,352 @@
+#include "RepositoryStorage.h"
+#include "Chunker.h"
+#include "utils.h"
+#include "Scheduler.h"
+#include <nlohmann/json.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+// Estructura del repositorio:
+//   config                    formato y parámetros del chunker
+//   chunks/ab/abcdef...       cada chunk: método de compresión (2 bytes) + datos comprimidos
+//   snapshots/<nombre>.json   manifiesto de cada respaldo: archivos y la lista de chunks de cada uno
+static const char* REPOSITORY_FORMAT = "backup_tool-repository 1";
+
+static std::string repository_config() {
+    return std::string(REPOSITORY_FORMAT) + "\nchunker fastcdc " + std::to_string(CHUNK_MIN_SIZE) + " " +
+           std::to_string(CHUNK_AVG_SIZE) + " " + std::to_string(CHUNK_MAX_SIZE) + "\n";
+}
+
+static fs::path chunk_path(const fs::path& repository, const std::string& hash) {
+    return repository / "chunks" / hash.substr(0, 2) / hash;
+}
+
+// Escribe en un archivo temporal y lo renombra: un chunk o manifiesto nunca queda a medias.
+// El temporal lleva el pid y el hilo: dos procesos pueden escribir el mismo chunk a la vez.
+static bool write_file_atomically(const fs::path& path, const unsigned char* data, size_t len) {
+    std::ostringstream tmp_name;
+    tmp_name << path.string() << ".tmp." << getpid() << "." << std::this_thread::get_id();
+    fs::path tmp_path = tmp_name.str();
+    {
+        std::ofstream out(tmp_path, std::ios::binary);
+        if (!out.write(reinterpret_cast<const char*>(data), len)) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp_path, path, ec);
+    if (ec) {
+        fs::remove(tmp_path, ec);
+        return false;
+    }
+    return true;
+}
+
+static bool read_whole_file(const fs::path& path, std::vector<unsigned char>& data) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) return false;
+    data.resize(in.tellg());
+    in.seekg(0);
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(data.data()), data.size()));
+}
+
+// Crea el repositorio si no existe o comprueba que el existente tiene el mismo formato.
+static bool open_repository(const fs::path& repository, bool create) {
+    fs::path config = repository / "config";
+    try {
+        if (!fs::exists(config)) {
+            if (!create) {
+                show_message("La carpeta seleccionada no es un repositorio de respaldos.");
+                return false;
+            }
+            fs::create_directories(repository / "snapshots");
+            // Los 256 subdirectorios de chunks se crean una vez para no crearlos durante el respaldo.
+            static const char hex[] = "0123456789abcdef";
+            for (int i = 0; i < 256; ++i) {
+                fs::create_directories(repository / "chunks" / std::string{hex[i >> 4], hex[i & 0xF]});
+            }
+            std::string text = repository_config();
+            return write_file_atomically(config, reinterpret_cast<const unsigned char*>(text.data()), text.size());
+        }
+    } catch (const std::exception& e) {
+        show_message("Error preparando el repositorio: " + std::string(e.what()));
+        return false;
+    }
+
+    std::vector<unsigned char> data;
+    if (!read_whole_file(config, data) || std::string(data.begin(), data.end()) != repository_config()) {
+        show_message("El repositorio tiene un formato o configuración de chunks incompatible.");
+        return false;
+    }
+    return true;
+}
+
+bool RepositoryStorage::validate() {
+    repository_folder = ask_repository_folder();
+    if (repository_folder.empty()) {
+        show_message("No se seleccionó la carpeta del repositorio.");
+        return false;
+    }
+    return true;
+}
+
+bool RepositoryStorage::backup(const std::vector<std::string>& folders) {
+    fs::path repository(repository_folder);
+    if (!open_repository(repository, true)) {
+        return false;
+    }
+
+    std::vector<ArchiveItem> items;
+    ScanStats scan;
+    try {
+        items = collect_backup_items(folders, nullptr, &scan);
+    } catch (const std::exception& e) {
+        show_message("Error recorriendo las carpetas a respaldar: " + std::string(e.what()));
+        return false;
+    }
+    CodecOptions codec = choose_codec();
+
+    std::atomic<uint64_t> new_chunks{0}, new_bytes{0}, stored_bytes{0}, reused_chunks{0}, reused_bytes{0};
+    std::atomic<bool> all_ok{true};
+    std::vector<json> entries(items.size());
+
+    // Cada archivo se procesa en paralelo: se corta en chunks y solo se escriben los que
+    // el repositorio todavía no tiene. En un disco rotacional, pocos a la vez y en el orden
+    // físico en que los deja collect_backup_items.
+    parallel_for_width(Lane::Cpu, items.size(), scan.readers, [&](size_t i) {
+        const ArchiveItem& item = items[i];
+        int fd = open(item.source.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            std::cerr << "Error abriendo " << item.source << std::endl;
+            if (fd >= 0) close(fd);
+            all_ok = false;
+            return;
+        }
+
+        json chunks = json::array();
+        uint64_t size = 0;
+        bool ok = chunk_file(fd, [&](const unsigned char* data, size_t len) {
+            std::string hash = sha256_hex(data, len);
+            chunks.push_back(hash);
+            size += len;
+            fs::path path = chunk_path(repository, hash);
+            if (fs::exists(path)) {
+                reused_chunks++;
+                reused_bytes += len;
+                return true;
+            }
+
+            std::vector<unsigned char> compressed;
+            uint16_t method = codec_method(codec.type);
+            if (!codec_compress(codec, data, len, nullptr, 0, true, false, compressed) || compressed.size() >= len) {
+                method = ZIP_METHOD_STORE;
+                compressed.assign(data, data + len);
+            }
+            compressed.insert(compressed.begin(), {static_cast<unsigned char>(method & 0xFF),
+                                                   static_cast<unsigned char>(method >> 8)});
+            if (!write_file_atomically(path, compressed.data(), compressed.size())) {
+                std::cerr << "Error escribiendo el chunk " << hash << std::endl;
+                return false;
+            }
+            new_chunks++;
+            new_bytes += len;
+            stored_bytes += compressed.size();
+            return true;
+        });
+        close(fd);
+        if (!ok) {
+            std::cerr << "Error respaldando " << item.source << std::endl;
+            all_ok = false;
+            return;
+        }
+
+        entries[i] = {{"path", item.name}, {"size", size}, {"mode", st.st_mode & 07777},
+                      {"mtime", st.st_mtime}, {"chunks", std::move(chunks)}};
+    });
+
+    if (!all_ok) {
+        show_message("Hubo errores al respaldar algunos archivos. No se creó el snapshot.");
+        return false;
+    }
+
+    // El manifiesto se escribe al final: el snapshot existe solo si todos sus chunks ya están guardados.
+    std::string snapshot_name = "snapshot_" + std::to_string(std::time(nullptr));
+    for (int n = 2; fs::exists(repository / "snapshots" / (snapshot_name + ".json")); ++n) {
+        snapshot_name = "snapshot_" + std::to_string(std::time(nullptr)) + "_" + std::to_string(n);
+    }
+    json manifest = {{"version", 1}, {"snapshot", snapshot_name}, {"created", std::time(nullptr)},
+                     {"codec", codec_name(codec.type)}, {"files", std::move(entries)}};
+    std::string text = manifest.dump();
+    if (!write_file_atomically(repository / "snapshots" / (snapshot_name + ".json"),
+                               reinterpret_cast<const unsigned char*>(text.data()), text.size())) {
+        show_message("Error escribiendo el manifiesto del snapshot.");
+        return false;
+    }
+
+    auto mb = [](uint64_t bytes) { return std::to_string(bytes / (1024 * 1024)); };
+    show_message("Snapshot creado: " + snapshot_name + "\n" +
+                 std::to_string(items.size()) + " archivos\n" +
+                 "Chunks nuevos: " + std::to_string(new_chunks) + " (" + mb(new_bytes) + " MB, " +
+                 mb(stored_bytes) + " MB escritos)\n" +
+                 "Chunks ya existentes: " + std::to_string(reused_chunks) + " (" + mb(reused_bytes) + " MB sin escribir)");
+    return true;
+}
+
+std::string RepositoryStorage::getDescription() const {
+    return "Repositorio con deduplicación";
+}
+
+std::string RepositoryStorage::ask_repository_folder() {
+    FILE* fp = popen("zenity --file-selection --directory --title=\"Selecciona la carpeta del repositorio de respaldos\"", "r");
+    if (!fp) return "";
+    char buffer[1024];
+    std::string path;
+    if (fgets(buffer, sizeof(buffer), fp)) {
+        path = buffer;
+        path.erase(path.find_last_not_of("\n\r") + 1);
+    }
+    pclose(fp);
+    return path;
+}
+
+// Reconstruye un archivo a partir de sus chunks, verificando el SHA-256 de cada uno.
+static bool restore_file(const fs::path& repository, const json& entry, const fs::path& destination) {
+    fs::path relative = safe_relative_path(entry["path"].get<std::string>());
+    if (relative.empty()) {
+        std::cerr << "Ruta no válida en el snapshot, se omite: " << entry["path"].get<std::string>() << std::endl;
+        return false;
+    }
+    fs::path target = destination / relative;
+    try {
+        fs::create_directories(target.parent_path());
+    } catch (const std::exception& e) {
+        std::cerr << "Error creando directorio padre para " << target << ": " << e.what() << std::endl;
+        return false;
+    }
+    std::ofstream out(target, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error creando archivo de salida: " << target << std::endl;
+        return false;
+    }
+
+    std::vector<unsigned char> stored, chunk;
+    for (const auto& hash_value : entry["chunks"]) {
+        std::string hash = hash_value.get<std::string>();
+        if (!read_whole_file(chunk_path(repository, hash), stored) || stored.size() < 2) {
+            std::cerr << "Falta el chunk " << hash << " de " << target << std::endl;
+            return false;
+        }
+        std::unique_ptr<Decoder> decoder = make_decoder(stored[0] | (stored[1] << 8));
+        chunk.clear();
+        auto sink = [&](const unsigned char* data, size_t len) {
+            chunk.insert(chunk.end(), data, data + len);
+            return true;
+        };
+        if (!decoder || !decoder->feed(stored.data() + 2, stored.size() - 2, sink) || !decoder->finish() ||
+            sha256_hex(chunk.data(), chunk.size()) != hash) {
+            std::cerr << "Chunk corrupto " << hash << " de " << target << std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+    }
+    out.close();
+    if (!out) {
+        std::cerr << "Error escribiendo " << target << std::endl;
+        return false;
+    }
+    chmod(target.c_str(), entry["mode"].get<unsigned>());
+    return true;
+}
+
+bool RepositoryStorage::restore() {
+    show_message("Iniciando restauración desde el Repositorio...");
+
+    fs::path repository(repository_folder);
+    if (!open_repository(repository, false)) {
+        return false;
+    }
+
+    // 1. Elegir los snapshots a restaurar
+    std::vector<std::string> snapshots;
+    try {
+        for (const auto& entry : fs::directory_iterator(repository / "snapshots")) {
+            if (entry.path().extension() == ".json") {
+                snapshots.push_back(entry.path().stem().string());
+            }
+        }
+    } catch (const std::exception& e) {
+        show_message("Error listando los snapshots: " + std::string(e.what()));
+        return false;
+    }
+    std::sort(snapshots.begin(), snapshots.end());
+    if (snapshots.empty()) {
+        show_message("El repositorio no tiene snapshots.");
+        return true;
+    }
+    std::vector<std::string> selected = select_files_from_list(snapshots);
+    if (selected.empty()) {
+        show_message("No se seleccionaron snapshots para restaurar.");
+        return true;
+    }
+
+    // 2. Elegir la carpeta de destino
+    std::string destination_folder_str = ask_restore_destination_folder();
+    if (destination_folder_str.empty()) {
+        show_message("No se seleccionó una carpeta de destino para la restauración.");
+        return false;
+    }
+    fs::path destination_folder(destination_folder_str);
+    try {
+        fs::create_directories(destination_folder);
+    } catch (const std::exception& e) {
+        show_message("Error creando la carpeta de destino: " + std::string(e.what()));
+        return false;
+    }
+
+    // 3. Reconstruir los archivos de cada snapshot en paralelo
+    bool all_restored = true;
+    for (const auto& name : selected) {
+        std::vector<unsigned char> text;
+        json manifest;
+        try {
+            if (!read_whole_file(repository / "snapshots" / (name + ".json"), text)) {
+                throw std::runtime_error("no se pudo leer");
+            }
+            manifest = json::parse(text.begin(), text.end());
+        } catch (const std::exception& e) {
+            show_message("Error leyendo el manifiesto de " + name + ": " + e.what());
+            all_restored = false;
+            continue;
+        }
+
+        const json& files = manifest["files"];
+        std::atomic<bool> ok{true};
+        parallel_for(Lane::Io, files.size(), [&](size_t i) {
+            if (!restore_file(repository, files[i], destination_folder)) {
+                ok = false;
+            }
+        });
+        if (!ok) {
+            show_message("Error restaurando algunos archivos de " + name + ".");
+            all_restored = false;
+        }
+    }
+
+    if (all_restored) {
+        show_message("Restauración desde el repositorio completada exitosamente.");
+    }
+    return all_restored;
+}
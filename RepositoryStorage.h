@@ -0,0 +1,23 @@
+#ifndef REPOSITORY_STORAGE_H
+#define REPOSITORY_STORAGE_H
+
+#include "StorageHandler.h"
+#include <string>
+// Clase que hereda de StorageHandler y guarda los respaldos en un repositorio con deduplicación:
+// los archivos se cortan en chunks definidos por contenido (FastCDC), cada chunk se guarda una sola
+// vez con su SHA-256 como nombre y cada respaldo (snapshot) es un manifiesto de referencias a chunks.
+class RepositoryStorage : public StorageHandler {
+private:
+    std::string repository_folder;
+
+public:
+    bool validate() override;
+    bool backup(const std::vector<std::string>& folders) override;
+    std::string getDescription() const override;
+    bool restore() override;
+
+private:
+    std::string ask_repository_folder();
+};
+
+#endif // REPOSITORY_STORAGE_H
@@ -0,0 +1,210 @@
+#include "Scheduler.h"
+#include "SystemLimits.h"
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Task {
+    std::function<void()> run;
+    TaskGroup* group = nullptr;
+};
+
+// Cola de tareas con su propio mutex: la de cada hilo, la de prioridad alta y la de entrada.
+struct TaskQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+
+    void push(Task task) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    bool pop_front(Task& task) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tasks.empty()) return false;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+        return true;
+    }
+    bool pop_back(Task& task) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tasks.empty()) return false;
+        task = std::move(tasks.back());
+        tasks.pop_back();
+        return true;
+    }
+};
+
+// Carril y posición del hilo actual (-1 fuera de los hilos del planificador).
+thread_local Lane worker_lane = Lane::Cpu;
+thread_local int worker_index = -1;
+
+std::atomic<unsigned> threads_override{0};
+
+unsigned default_cpu_threads() {
+    if (const char* env = std::getenv("BACKUP_TOOL_THREADS")) {
+        int threads = std::atoi(env);
+        if (threads > 0) return static_cast<unsigned>(threads);
+    }
+    return system_limits().effective_cpus;
+}
+
+unsigned cpu_threads() {
+    unsigned threads = threads_override.load(std::memory_order_relaxed);
+    if (threads > 0) return threads;
+    static const unsigned fallback = default_cpu_threads();
+    return fallback;
+}
+
+} // namespace
+
+// Hilos y colas de un carril.
+class LanePool {
+public:
+    LanePool(Lane lane, unsigned count) : lane(lane) {
+        for (unsigned i = 0; i < count; ++i) {
+            locals.push_back(std::make_unique<TaskQueue>());
+        }
+        for (unsigned i = 0; i < count; ++i) {
+            // Los hilos no se unen nunca: duermen hasta que termina el proceso.
+            std::thread([this, i] { work(static_cast<int>(i)); }).detach();
+        }
+    }
+
+    unsigned size() const { return static_cast<unsigned>(locals.size()); }
+
+    void submit(Task task, Priority priority) {
+        // Se cuenta antes de encolar para que 'queued' nunca quede por debajo de lo encolado.
+        queued.fetch_add(1);
+        if (priority == Priority::High) {
+            high.push(std::move(task));
+        } else if (worker_index >= 0 && worker_lane == lane) {
+            locals[worker_index]->push(std::move(task));
+        } else {
+            incoming.push(std::move(task));
+        }
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        if (sleeping > 0) wake.notify_one();
+    }
+
+    // Ejecuta una tarea pendiente si la hay. 'self' es el hilo que la busca (o -1).
+    bool run_one(int self) {
+        Task task;
+        if (!take(self, task)) return false;
+        std::exception_ptr error;
+        try {
+            task.run();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        task.run = nullptr; // Lo capturado se libera antes de avisar al grupo
+        task.group->finish(error);
+        return true;
+    }
+
+private:
+    // Orden: prioridad alta, la cola propia por el final, las que llegan de fuera y, por
+    // último, robar por el principio de la cola de otro hilo.
+    bool take(int self, Task& task) {
+        if (queued.load() == 0) return false;
+        bool found = high.pop_front(task) || (self >= 0 && locals[self]->pop_back(task)) || incoming.pop_front(task);
+        for (unsigned k = 1; !found && k <= size(); ++k) {
+            unsigned victim = (static_cast<unsigned>(self < 0 ? 0 : self) + k) % size();
+            found = locals[victim]->pop_front(task);
+        }
+        if (found) queued.fetch_sub(1);
+        return found;
+    }
+
+    void work(int self) {
+        worker_lane = lane;
+        worker_index = self;
+        for (;;) {
+            if (run_one(self)) continue;
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            // 'queued' sube antes de que submit() tome el mutex: no se pierde ningún aviso.
+            while (queued.load() == 0) {
+                sleeping++;
+                wake.wait(lock);
+                sleeping--;
+            }
+        }
+    }
+
+    Lane lane;
+    std::vector<std::unique_ptr<TaskQueue>> locals;
+    TaskQueue high;
+    TaskQueue incoming;
+    std::atomic<size_t> queued{0};
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    unsigned sleeping = 0;
+};
+
+// Los carriles se crean con la primera tarea y no se destruyen.
+static LanePool& lane_pool(Lane lane) {
+    static LanePool* cpu = new LanePool(Lane::Cpu, scheduler_threads(Lane::Cpu));
+    static LanePool* io = new LanePool(Lane::Io, scheduler_threads(Lane::Io));
+    return lane == Lane::Cpu ? *cpu : *io;
+}
+
+unsigned scheduler_threads(Lane lane) {
+    unsigned cpu = cpu_threads();
+    if (lane == Lane::Cpu) return cpu;
+    // Las lecturas de un disco rotacional se limitan por carpeta (choose_read_schedule), no
+    // aquí: el carril también sirve a los SSD, las descargas y las subidas.
+    return std::max(SCHEDULER_MIN_IO_THREADS, 2 * cpu);
+}
+
+void set_scheduler_threads(unsigned cpu_threads) {
+    threads_override.store(cpu_threads, std::memory_order_relaxed);
+}
+
+int current_worker(Lane lane) {
+    return worker_index >= 0 && worker_lane == lane ? worker_index : -1;
+}
+
+TaskGroup::~TaskGroup() {
+    // Las tareas usan el grupo hasta terminar; una excepción sin recoger se descarta.
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    pending.fetch_add(1);
+    lane_pool(lane).submit(Task{std::move(task), this}, priority);
+}
+
+void TaskGroup::finish(std::exception_ptr error) {
+    // Con el mutex tomado: quien espera no puede destruir el grupo mientras se avisa.
+    std::lock_guard<std::mutex> lock(mutex);
+    if (error && !first_error) first_error = error;
+    if (pending.fetch_sub(1) == 1) done.notify_all();
+}
+
+void TaskGroup::wait() {
+    int self = current_worker(lane);
+    while (pending.load() > 0) {
+        if (self >= 0 && lane_pool(lane).run_one(self)) continue;
+        std::unique_lock<std::mutex> lock(mutex);
+        if (self >= 0) {
+            // Un hilo del carril vuelve a mirar las colas de vez en cuando: otras tareas del
+            // grupo pueden crear tareas nuevas que él podría adelantar.
+            done.wait_for(lock, std::chrono::milliseconds(1), [&] { return pending.load() == 0; });
+        } else {
+            done.wait(lock, [&] { return pending.load() == 0; });
+        }
+    }
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(mutex); // La última tarea ya soltó el mutex
+        std::swap(error, first_error);
+    }
+    if (error) std::rethrow_exception(error);
+}
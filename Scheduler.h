@@ -0,0 +1,101 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+
+// Planificador único de las tareas paralelas del programa (recorrido, lectura, compresión,
+// escritura, copia y restauración). Tiene dos carriles con sus propios hilos:
+// - Cpu: trabajo de cálculo (compresión, firmas, chunks). Tantos hilos como núcleos.
+// - Io: trabajo que pasa la mayor parte del tiempo bloqueado en el disco o en la red (lecturas,
+//   copias, escritura del ZIP). Más hilos, para que una tarea bloqueada no deje el disco parado.
+// Así la compresión nunca ocupa los hilos que necesita la escritura, y al revés.
+// Dentro de cada carril el reparto es por robo de trabajo: cada hilo tiene su cola, las tareas
+// que crea una tarea van a la cola de su hilo (la última en entrar es la primera en salir, con
+// sus datos aún en la caché) y un hilo sin trabajo roba las más antiguas de otro.
+// Las tareas de prioridad alta van a una cola del carril que todos sus hilos miran antes que
+// la suya: el escritor del respaldo no queda detrás de las lecturas encoladas.
+enum class Lane { Cpu, Io };
+enum class Priority { Normal, High };
+
+// Hilos de cada carril. Cpu: la variable de entorno BACKUP_TOOL_THREADS o, por defecto, las
+// CPU efectivas (system_limits(): afinidad y cuota del cgroup). Io: el doble que Cpu, como
+// mínimo SCHEDULER_MIN_IO_THREADS.
+unsigned scheduler_threads(Lane lane);
+// Fija los hilos del carril Cpu (y con ellos los de Io). Solo tiene efecto antes de la
+// primera tarea: después los hilos ya están creados.
+void set_scheduler_threads(unsigned cpu_threads);
+// Una etapa larga del carril Io (la lectura del respaldo) puede quedarse esperando a otra (la
+// escritura): con este mínimo siempre queda un hilo libre para ella.
+constexpr unsigned SCHEDULER_MIN_IO_THREADS = 4;
+
+// Índice del hilo actual en el carril [0, scheduler_threads(lane)), o -1 si no es uno de sus
+// hilos. Sirve para el estado de cada hilo (un anillo, un buffer) sin thread_local.
+int current_worker(Lane lane);
+
+// Grupo de tareas que se espera junto, como tbb::task_group.
+class TaskGroup {
+public:
+    explicit TaskGroup(Lane lane, Priority priority = Priority::Normal) : lane(lane), priority(priority) {}
+    ~TaskGroup();
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    // Se puede llamar desde cualquier hilo, también desde las tareas del grupo.
+    void run(std::function<void()> task);
+    // Espera a todas las tareas del grupo. Un hilo del mismo carril ejecuta tareas pendientes
+    // mientras espera, así que esperar dentro de una tarea no bloquea el carril. Relanza la
+    // primera excepción que haya salido de una tarea.
+    void wait();
+
+private:
+    friend class LanePool;
+    void finish(std::exception_ptr error);
+
+    Lane lane;
+    Priority priority;
+    std::atomic<size_t> pending{0};
+    std::mutex mutex;
+    std::condition_variable done;
+    std::exception_ptr first_error;
+};
+
+// Reparte los índices [0, n) entre hasta 'width' tareas (0: scheduler_threads(lane)) que van
+// tomando el siguiente índice libre, en orden (como schedule(dynamic, 1)): un elemento lento
+// no retrasa a los demás. Cada tarea crea su estado con 'init()' y llama a 'body(state, i)'.
+template <typename Init, typename Body>
+void parallel_for(Lane lane, size_t n, Init init, Body body, size_t width = 0) {
+    if (n == 0) return;
+    std::atomic<size_t> next{0};
+    size_t tasks = std::min<size_t>(n, width > 0 ? width : scheduler_threads(lane));
+    TaskGroup group(lane);
+    for (size_t t = 0; t < tasks; ++t) {
+        group.run([&] {
+            auto state = init();
+            for (size_t i = next++; i < n; i = next++) {
+                body(state, i);
+            }
+        });
+    }
+    group.wait();
+}
+
+// Igual, sin estado por tarea: 'body(i)'.
+template <typename Body>
+void parallel_for(Lane lane, size_t n, Body body) {
+    parallel_for(lane, n, [] { return 0; }, [&](int, size_t i) { body(i); });
+}
+
+// Como parallel_for, pero con como mucho 'width' índices a la vez (por ejemplo, pocas lecturas
+// simultáneas en un disco rotacional).
+template <typename Body>
+void parallel_for_width(Lane lane, size_t n, size_t width, Body body) {
+    parallel_for(lane, n, [] { return 0; }, [&](int, size_t i) { body(i); }, width);
+}
+
+#endif // SCHEDULER_H
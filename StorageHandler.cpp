@@ -2,6 +2,7 @@
 #include "LocalStorage.h"
 #include "CloudStorage.h"
 #include "UsbStorage.h"
+#include "RepositoryStorage.h"
 
 // Deficinicion de la factory para crear cada tipo de almacenamiento
 std::unique_ptr<StorageHandler> createStorageHandler(const std::string& type) {
@@ -11,6 +12,8 @@ std::unique_ptr<StorageHandler> createStorageHandler(const std::string& type) {
         return std::make_unique<CloudStorage>();
     } else if (type == "USB") {
         return std::make_unique<UsbStorage>();
+    } else if (type == "Repositorio") {
+        return std::make_unique<RepositoryStorage>();
     }
     return nullptr;
 }
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include "StreamBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+StreamBuffer::StreamBuffer(size_t capacity) : ring(capacity) {}
+
+bool StreamBuffer::write(const void* data, size_t len) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::unique_lock<std::mutex> lock(mutex);
+    while (len > 0) {
+        not_full.wait(lock, [&] { return cancelled || used < ring.size(); });
+        if (cancelled) {
+            return false;
+        }
+        // Copiar en el hueco libre, que puede estar partido en dos por el final del anillo.
+        size_t tail = (head + used) % ring.size();
+        size_t n = std::min({len, ring.size() - used, ring.size() - tail});
+        std::memcpy(ring.data() + tail, bytes, n);
+        used += n;
+        bytes += n;
+        len -= n;
+        not_empty.notify_one();
+    }
+    return true;
+}
+
+void StreamBuffer::close(bool ok) {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    producer_ok = ok;
+    not_empty.notify_all();
+}
+
+size_t StreamBuffer::read(void* out, size_t max) {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_empty.wait(lock, [&] { return used > 0 || closed; });
+    size_t n = std::min({max, used, ring.size() - head});
+    std::memcpy(out, ring.data() + head, n);
+    head = (head + n) % ring.size();
+    used -= n;
+    not_full.notify_one();
+    return n;
+}
+
+void StreamBuffer::cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    cancelled = true;
+    not_full.notify_all();
+}
+
+bool StreamBuffer::failed() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return closed && !producer_ok;
+}
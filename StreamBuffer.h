@@ -0,0 +1,40 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Buffer circular acotado entre un productor (el escritor del ZIP) y un consumidor (cURL
+// leyendo el cuerpo de la petición). El productor se bloquea cuando el buffer está lleno, así
+// que la compresión avanza al ritmo de la red sin guardar el ZIP completo en ningún lado.
+class StreamBuffer {
+public:
+    explicit StreamBuffer(size_t capacity);
+
+    // Lado del productor. 'write' devuelve false si el consumidor canceló.
+    bool write(const void* data, size_t len);
+    // Fin de los datos: 'ok' indica si el productor terminó sin errores.
+    void close(bool ok);
+
+    // Lado del consumidor. Copia hasta 'max' bytes; devuelve 0 al llegar al final.
+    size_t read(void* out, size_t max);
+    // El consumidor deja de leer (error de red): desbloquea al productor.
+    void cancel();
+    // Indica si el productor cerró con error.
+    bool failed();
+
+private:
+    std::vector<unsigned char> ring;
+    size_t head = 0; // Próximo byte a leer
+    size_t used = 0;
+    bool closed = false;
+    bool producer_ok = true;
+    bool cancelled = false;
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+};
+
+#endif // STREAM_BUFFER_H
@@ -0,0 +1,235 @@
+#include "SystemLimits.h"
+#include "IoEngine.h"
+#include "Pipeline.h"
+#include "Scheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+// memory.limit_in_bytes de cgroup v1 sin límite es un número enorme (redondeado a página).
+static constexpr uint64_t V1_UNLIMITED = 1ull << 60;
+
+// Primera palabra de la primera línea de 'path' (o todo, con 'whole_line').
+static bool read_value(const fs::path& path, std::string& value, bool whole_line = false) {
+    std::ifstream in(path);
+    if (!in) return false;
+    if (whole_line) return static_cast<bool>(std::getline(in, value));
+    return static_cast<bool>(in >> value);
+}
+
+// Ruta del proceso en la jerarquía de 'controller' según /proc/self/cgroup ("" para la de v2,
+// la línea "0::/ruta").
+static bool cgroup_path(const fs::path& proc, const std::string& controller, std::string& path) {
+    std::ifstream in(proc / "self" / "cgroup");
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t first = line.find(':');
+        size_t second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos) continue;
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        bool match = controller.empty() ? controllers.empty() : false;
+        std::stringstream list(controllers);
+        std::string name;
+        while (!controller.empty() && std::getline(list, name, ',')) {
+            match = match || name == controller;
+        }
+        if (match) {
+            path = line.substr(second + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Llama a 'visit' con cada directorio desde el cgroup del proceso hasta la raíz del montaje:
+// el límite efectivo es el menor de toda la cadena. Sin espacio de nombres de cgroup la ruta
+// del anfitrión puede no existir en el contenedor; entonces cuenta la raíz del montaje.
+template <typename Visit>
+static void walk_up(const fs::path& mount, const std::string& path, Visit visit) {
+    std::error_code ec;
+    fs::path dir = mount / fs::path(path).relative_path();
+    for (;;) {
+        if (fs::is_directory(dir, ec)) visit(dir);
+        if (dir == mount || !dir.has_relative_path() || dir.parent_path() == dir) break;
+        dir = dir.parent_path();
+    }
+}
+
+// Cuota de CPU (en CPUs) y límite de memoria de cgroup v2. Devuelve true si se leyó algo.
+static bool read_cgroup_v2(const fs::path& sys, const fs::path& proc, double& quota, uint64_t& memory) {
+    std::error_code ec;
+    fs::path mount = sys / "fs" / "cgroup";
+    if (!fs::exists(mount / "cgroup.controllers", ec)) {
+        mount = sys / "fs" / "cgroup" / "unified"; // Jerarquía híbrida
+        if (!fs::exists(mount / "cgroup.controllers", ec)) return false;
+    }
+    std::string path;
+    if (!cgroup_path(proc, "", path)) return false;
+    bool found = false;
+    walk_up(mount, path, [&](const fs::path& dir) {
+        std::string line;
+        if (read_value(dir / "cpu.max", line, true)) {
+            found = true;
+            std::istringstream in(line);
+            std::string max;
+            double period = 0;
+            if (in >> max >> period && max != "max" && period > 0) {
+                double cpus = std::atof(max.c_str()) / period;
+                if (cpus > 0 && (quota == 0 || cpus < quota)) quota = cpus;
+            }
+        }
+        std::string value;
+        if (read_value(dir / "memory.max", value)) {
+            found = true;
+            uint64_t bytes = value == "max" ? 0 : std::strtoull(value.c_str(), nullptr, 10);
+            if (bytes > 0 && (memory == 0 || bytes < memory)) memory = bytes;
+        }
+    });
+    return found;
+}
+
+static bool read_cgroup_v1(const fs::path& sys, const fs::path& proc, double& quota, uint64_t& memory) {
+    std::error_code ec;
+    bool found = false;
+    std::string path;
+    if (cgroup_path(proc, "cpu", path)) {
+        for (const char* name : {"cpu", "cpu,cpuacct"}) {
+            fs::path mount = sys / "fs" / "cgroup" / name;
+            if (!fs::is_directory(mount, ec)) continue;
+            walk_up(mount, path, [&](const fs::path& dir) {
+                std::string quota_us, period_us;
+                if (!read_value(dir / "cpu.cfs_quota_us", quota_us) || !read_value(dir / "cpu.cfs_period_us", period_us)) {
+                    return;
+                }
+                found = true;
+                double q = std::atof(quota_us.c_str());
+                double p = std::atof(period_us.c_str());
+                if (q > 0 && p > 0 && (quota == 0 || q / p < quota)) quota = q / p;
+            });
+            break;
+        }
+    }
+    if (cgroup_path(proc, "memory", path)) {
+        walk_up(sys / "fs" / "cgroup" / "memory", path, [&](const fs::path& dir) {
+            std::string value;
+            if (!read_value(dir / "memory.limit_in_bytes", value)) return;
+            found = true;
+            uint64_t bytes = std::strtoull(value.c_str(), nullptr, 10);
+            if (bytes > 0 && bytes < V1_UNLIMITED && (memory == 0 || bytes < memory)) memory = bytes;
+        });
+    }
+    return found;
+}
+
+// Dispositivos que no son discos: no dicen nada del almacenamiento de los respaldos.
+static bool is_virtual_block_device(const std::string& name) {
+    for (const char* prefix : {"loop", "ram", "zram", "dm-", "md", "sr", "fd", "nbd"}) {
+        if (name.rfind(prefix, 0) == 0) return true;
+    }
+    return false;
+}
+
+uint64_t SystemLimits::usable_memory() const {
+    if (memory_limit > 0 && (physical_memory == 0 || memory_limit < physical_memory)) return memory_limit;
+    return physical_memory;
+}
+
+SystemLimits detect_system_limits(const fs::path& sys, const fs::path& proc) {
+    SystemLimits limits;
+    limits.online_cpus = std::max(1u, std::thread::hardware_concurrency());
+    limits.affinity_cpus = limits.online_cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0) {
+        limits.affinity_cpus = static_cast<unsigned>(CPU_COUNT(&set));
+    }
+
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0) {
+        limits.physical_memory = static_cast<uint64_t>(pages) * static_cast<uint64_t>(page_size);
+    }
+
+    if (read_cgroup_v2(sys, proc, limits.cpu_quota, limits.memory_limit)) {
+        limits.cgroup_version = 2;
+    } else if (read_cgroup_v1(sys, proc, limits.cpu_quota, limits.memory_limit)) {
+        limits.cgroup_version = 1;
+    }
+    limits.effective_cpus = std::min(limits.online_cpus, limits.affinity_cpus);
+    if (limits.cpu_quota > 0) {
+        // Una cuota de 1.5 CPUs deja trabajar a dos hilos la mayor parte del tiempo.
+        unsigned quota = static_cast<unsigned>(std::ceil(limits.cpu_quota));
+        limits.effective_cpus = std::max(1u, std::min(limits.effective_cpus, quota));
+    }
+
+    std::error_code ec;
+    std::vector<std::string> names;
+    for (const fs::directory_entry& entry : fs::directory_iterator(sys / "block", ec)) {
+        std::string name = entry.path().filename().string();
+        if (!is_virtual_block_device(name)) names.push_back(name);
+    }
+    std::sort(names.begin(), names.end());
+    for (const std::string& name : names) {
+        std::string value;
+        if (!read_value(sys / "block" / name / "queue" / "rotational", value)) continue;
+        bool rotational = value == "1";
+        limits.disks += (limits.disks.empty() ? "" : ", ") + name + (rotational ? " (rotacional)" : " (SSD)");
+    }
+    return limits;
+}
+
+const SystemLimits& system_limits() {
+    static const SystemLimits limits = detect_system_limits();
+    return limits;
+}
+
+bool path_is_rotational(const fs::path& path, const fs::path& sys) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || major(st.st_dev) == 0) return false;
+    std::error_code ec;
+    fs::path link = sys / "dev" / "block" / (std::to_string(major(st.st_dev)) + ":" + std::to_string(minor(st.st_dev)));
+    fs::path device = fs::canonical(link, ec);
+    if (ec) return false;
+    fs::path root = fs::canonical(sys, ec);
+    if (ec) return false;
+    for (fs::path dir = device; dir != root && dir.has_relative_path(); dir = dir.parent_path()) {
+        std::string value;
+        if (read_value(dir / "queue" / "rotational", value)) return value == "1";
+    }
+    return false;
+}
+
+std::string describe_tuning() {
+    const SystemLimits& limits = system_limits();
+    auto mb = [](uint64_t bytes) { return bytes / (1024.0 * 1024.0); };
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(0);
+    out << "Recursos: " << limits.effective_cpus << " CPU efectivas (" << limits.online_cpus << " en línea, "
+        << limits.affinity_cpus << " en la afinidad";
+    if (limits.cpu_quota > 0) {
+        out << std::setprecision(2) << ", cuota del cgroup v" << limits.cgroup_version << " de " << limits.cpu_quota
+            << std::setprecision(0);
+    }
+    out << "); memoria " << mb(limits.usable_memory()) << " MB";
+    if (limits.memory_limit > 0) {
+        out << " (límite del cgroup v" << limits.cgroup_version << " " << mb(limits.memory_limit) << " MB, física "
+            << mb(limits.physical_memory) << " MB)";
+    }
+    out << "; discos: " << (limits.disks.empty() ? "desconocidos" : limits.disks) << "\n";
+
+    uint64_t budget = memory_budget();
+    out << "Ajuste: " << scheduler_threads(Lane::Cpu) << " hilos de CPU, " << scheduler_threads(Lane::Io)
+        << " hilos de E/S, " << io_queue_depth() << " operaciones de E/S en vuelo, presupuesto de memoria "
+        << mb(budget) << " MB (hasta " << pipeline_buffer_count(budget) << " buffers de "
+        << mb(PIPELINE_BUFFER_SIZE) << " MB)";
+    return out.str();
+}
@@ -0,0 +1,46 @@
+#ifndef SYSTEM_LIMITS_H
+#define SYSTEM_LIMITS_H
+
+#include <cstdint>
+#include <string>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Recursos que el proceso puede usar de verdad. En un contenedor hardware_concurrency() y la
+// RAM física son los de la máquina: la cuota de CPU y el límite de memoria del cgroup (v2:
+// cpu.max y memory.max; v1: cpu.cfs_quota_us y memory.limit_in_bytes) son los que cuentan.
+// De aquí salen los valores por defecto de los hilos del planificador y el presupuesto de
+// memoria del pipeline.
+struct SystemLimits {
+    unsigned online_cpus = 1;     // hardware_concurrency()
+    unsigned affinity_cpus = 1;   // CPUs en la máscara de afinidad del proceso
+    double cpu_quota = 0;         // CPUs de la cuota del cgroup (0: sin cuota)
+    unsigned effective_cpus = 1;  // Lo menor de lo anterior (la cuota redondeada hacia arriba)
+    uint64_t physical_memory = 0;
+    uint64_t memory_limit = 0;    // Límite del cgroup (0: sin límite)
+    int cgroup_version = 0;       // 2, 1 o 0 si no se encontró ninguno
+    // Discos de /sys/block con su tipo (queue/rotational), solo para el informe: que haya un
+    // disco giratorio en la máquina no dice nada del que se va a leer (path_is_rotational).
+    std::string disks;
+
+    // Memoria que de verdad se puede usar: la física o el límite del cgroup si es menor.
+    uint64_t usable_memory() const;
+};
+
+// Mide los límites leyendo 'sys' (/sys) y 'proc' (/proc); con otras rutas se puede probar
+// sobre un árbol de archivos falso.
+SystemLimits detect_system_limits(const fs::path& sys = "/sys", const fs::path& proc = "/proc");
+// Los del proceso, medidos la primera vez que se piden.
+const SystemLimits& system_limits();
+
+// El disco donde está 'path' es rotacional: se busca queue/rotational subiendo desde
+// /sys/dev/block/MAYOR:MENOR de su st_dev (una partición no lo tiene, su disco sí). Si el
+// sistema de archivos no está sobre un solo disco (overlay, tmpfs, btrfs) o no se puede
+// averiguar, se responde false: sin saberlo se usa el reparto ancho de siempre.
+bool path_is_rotational(const fs::path& path, const fs::path& sys = "/sys");
+
+// Informe de arranque: los recursos detectados y los valores que se eligieron con ellos.
+std::string describe_tuning();
+
+#endif // SYSTEM_LIMITS_H
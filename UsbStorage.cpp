@@ -1,26 +1,66 @@
 #include "UsbStorage.h"
 #include "utils.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
 
 bool UsbStorage::validate() {
     // Implementación futura:
     // - Detectar dispositivos USB montados
-    // - Verificar permisos de escritura
     // - Comprobar espacio disponible
     // - Permitir selección si hay múltiples dispositivos
+    FILE* fp = popen("zenity --file-selection --directory --title=\"Selecciona carpeta de destino para el respaldo en el USB\"", "r");
+    if (!fp) return false;
+    char buffer[1024];
+    if (fgets(buffer, sizeof(buffer), fp)) {
+        destination_folder = buffer;
+        destination_folder.erase(destination_folder.find_last_not_of("\n\r") + 1);
+    }
+    pclose(fp);
+    if (destination_folder.empty()) {
+        show_message("No se seleccionó una carpeta en el dispositivo USB.");
+        return false;
+    }
     return true;
 }
 
 bool UsbStorage::backup(const std::vector<std::string>& folders) {
-    show_message("Iniciando transferencia a USB...\n(Implementación pendiente)");
-    
-    // Implementación futura:
-    // 1. Listar dispositivos USB disponibles
-    // 2. Permitir al usuario seleccionar dispositivo
-    // 3. Verificar espacio suficiente
-    // 4. Copiar carpetas directamente o crear ZIP según preferencia
-    // 5. Verificar integridad de la copia
-    // 6. Expulsar dispositivo de forma segura (opcional)
-    
+    // Cada carpeta se copia bajo su propio nombre. En btrfs/XFS la copia es un reflink (los
+    // bloques se comparten); entre dispositivos distintos, copy_file_range o sendfile.
+    std::vector<std::string> used_names;
+    std::vector<std::string> error_messages;
+    CopyReport report;
+    set_cache_policy(choose_cache_policy());
+    for (const auto& folder : folders) {
+        fs::path source_path(folder);
+        std::string name = source_path.filename().string();
+        if (name.empty()) {
+            name = source_path.parent_path().filename().string(); // Rutas terminadas en '/'
+        }
+        std::string unique_name = name;
+        for (int n = 2; std::find(used_names.begin(), used_names.end(), unique_name) != used_names.end(); ++n) {
+            unique_name = name + "_" + std::to_string(n);
+        }
+        used_names.push_back(unique_name);
+
+        if (!copy_directory(source_path, fs::path(destination_folder) / unique_name, &report)) {
+            error_messages.push_back("No se pudo copiar: " + folder);
+        }
+    }
+
+    std::string summary = describe_copy_report(report);
+    std::cout << summary;
+    if (!error_messages.empty()) {
+        std::string combined_errors;
+        for (const auto& error : error_messages) {
+            combined_errors += error + "\n";
+        }
+        show_message("Hubo errores copiando al USB:\n" + combined_errors);
+        return false;
+    }
+    show_message("Respaldo en USB completado en " + destination_folder + "\n\n" + summary);
     return true;
 }
 
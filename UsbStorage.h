@@ -2,8 +2,14 @@
 #define USB_STORAGE_H
 
 #include "StorageHandler.h"
+#include <string>
 
+// Respaldo espejo en un dispositivo USB: las carpetas se copian tal cual (sin ZIP) a la
+// carpeta elegida dentro del dispositivo montado.
 class UsbStorage : public StorageHandler {
+private:
+    std::string destination_folder;
+
 public:
     bool validate() override;
     bool backup(const std::vector<std::string>& folders) override;
@@ -11,4 +17,4 @@ public:
     bool restore() override;
 };
 
-#endif // USB_STORAGE_H
\ No newline at end of file
+#endif // USB_STORAGE_H
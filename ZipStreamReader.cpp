@@ -0,0 +1,180 @@
+#include "ZipStreamReader.h"
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+static constexpr uint32_t DESCRIPTOR_SIGNATURE = 0x08074b50;
+static constexpr uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+static constexpr uint32_t END_OF_CENTRAL_SIGNATURE = 0x06054b50;
+static constexpr uint32_t ZIP64_END_OF_CENTRAL_SIGNATURE = 0x06064b50;
+static constexpr size_t LOCAL_HEADER_SIZE = 30;
+static constexpr uint32_t ZIP32_MAX = 0xFFFFFFFFu;
+
+static uint16_t get16(const unsigned char* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const unsigned char* p) {
+    return static_cast<uint32_t>(get16(p)) | (static_cast<uint32_t>(get16(p + 2)) << 16);
+}
+
+static uint64_t get64(const unsigned char* p) {
+    return static_cast<uint64_t>(get32(p)) | (static_cast<uint64_t>(get32(p + 4)) << 32);
+}
+
+ZipStreamReader::ZipStreamReader(EntryBegin on_begin, EntryData on_data, EntryEnd on_end)
+    : on_begin(std::move(on_begin)), on_data(std::move(on_data)), on_end(std::move(on_end)) {}
+
+bool ZipStreamReader::fail(const std::string& text) {
+    state = State::Failed;
+    message = text;
+    return false;
+}
+
+bool ZipStreamReader::feed(const void* data, size_t len) {
+    if (state == State::Failed) return false;
+    if (state == State::Done) return true; // El directorio central no hace falta
+
+    // Descartar lo ya procesado antes de crecer el buffer.
+    if (pos > 0 && pos >= pending.size() / 2) {
+        pending.erase(pending.begin(), pending.begin() + pos);
+        pos = 0;
+    }
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    pending.insert(pending.end(), bytes, bytes + len);
+
+    // Avanzar mientras haya bytes suficientes para el siguiente paso.
+    while (state == State::Header || state == State::Data) {
+        size_t before = pos;
+        State previous = state;
+        if (!(state == State::Header ? parse_header() : parse_data())) return false;
+        if (pos == before && state == previous) break;
+    }
+    return true;
+}
+
+bool ZipStreamReader::parse_header() {
+    if (available() < 4) return true;
+    const unsigned char* p = pending.data() + pos;
+    uint32_t signature = get32(p);
+    if (signature == CENTRAL_HEADER_SIGNATURE || signature == END_OF_CENTRAL_SIGNATURE ||
+        signature == ZIP64_END_OF_CENTRAL_SIGNATURE) {
+        state = State::Done;
+        return true;
+    }
+    if (signature != LOCAL_HEADER_SIGNATURE) {
+        return fail("firma desconocida en la posición de una cabecera local");
+    }
+    if (available() < LOCAL_HEADER_SIZE) return true;
+    uint16_t name_len = get16(p + 26);
+    uint16_t extra_len = get16(p + 28);
+    if (available() < LOCAL_HEADER_SIZE + name_len + extra_len) return true;
+
+    uint16_t flags = get16(p + 6);
+    entry = ZipStreamEntry();
+    entry.method = get16(p + 8);
+    entry.crc = get32(p + 14);
+    entry.compressed_size = get32(p + 18);
+    entry.size = get32(p + 22);
+    entry.descriptor = (flags & 0x0008) != 0;
+    if (flags & 0x0001) {
+        return fail("las entradas cifradas no están soportadas");
+    }
+    entry.name.assign(reinterpret_cast<const char*>(p + LOCAL_HEADER_SIZE), name_len);
+
+    // Extra ZIP64: en la cabecera local trae los tamaños que no caben en 32 bits.
+    const unsigned char* extra = p + LOCAL_HEADER_SIZE + name_len;
+    const unsigned char* extra_end = extra + extra_len;
+    while (extra + 4 <= extra_end) {
+        uint16_t id = get16(extra);
+        uint16_t size = get16(extra + 2);
+        const unsigned char* field = extra + 4;
+        if (field + size > extra_end) break;
+        if (id == 0x0001) {
+            entry.zip64 = true;
+            const unsigned char* value = field;
+            if (entry.size == ZIP32_MAX && value + 8 <= field + size) {
+                entry.size = get64(value);
+                value += 8;
+            }
+            if (entry.compressed_size == ZIP32_MAX && value + 8 <= field + size) {
+                entry.compressed_size = get64(value);
+            }
+        }
+        extra = field + size;
+    }
+
+    pos += LOCAL_HEADER_SIZE + name_len + extra_len;
+    consumed = 0;
+    if (!on_begin(entry)) {
+        return fail("no se pudo preparar la entrada " + entry.name);
+    }
+    state = State::Data;
+    return true;
+}
+
+bool ZipStreamReader::parse_data() {
+    const unsigned char* p = pending.data() + pos;
+    size_t avail = available();
+
+    if (!entry.descriptor) {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(avail, entry.compressed_size - consumed));
+        if (n > 0 && !on_data(p, n)) {
+            return fail("error al escribir la entrada " + entry.name);
+        }
+        pos += n;
+        consumed += n;
+        if (consumed == entry.compressed_size) {
+            if (!on_end(entry)) return fail("la entrada " + entry.name + " está dañada");
+            state = State::Header;
+        }
+        return true;
+    }
+
+    // Con descriptor: los datos terminan en la firma del descriptor cuyo tamaño comprimido
+    // coincide con lo leído. Una firma que aparece dentro de los datos no cumple esa condición.
+    const size_t descriptor_size = entry.zip64 ? 24 : 16;
+    size_t safe = avail; // Bytes que seguro son datos
+    for (size_t i = 0; i + 4 <= avail; ++i) {
+        const void* found = std::memchr(p + i, 0x50, avail - 3 - i);
+        if (!found) break;
+        i = static_cast<const unsigned char*>(found) - p;
+        if (get32(p + i) != DESCRIPTOR_SIGNATURE) continue;
+        if (i + descriptor_size > avail) {
+            safe = i; // Candidato incompleto: esperar al resto
+            break;
+        }
+        uint64_t compressed = entry.zip64 ? get64(p + i + 8) : get32(p + i + 8);
+        if (compressed != consumed + i) continue;
+
+        if (i > 0 && !on_data(p, i)) {
+            return fail("error al escribir la entrada " + entry.name);
+        }
+        entry.crc = get32(p + i + 4);
+        entry.compressed_size = compressed;
+        entry.size = entry.zip64 ? get64(p + i + 16) : get32(p + i + 12);
+        pos += i + descriptor_size;
+        consumed += i;
+        if (!on_end(entry)) return fail("la entrada " + entry.name + " está dañada");
+        state = State::Header;
+        return true;
+    }
+    // Los últimos bytes pueden ser el comienzo de una firma partida entre dos bloques.
+    if (safe == avail) {
+        safe = avail >= 3 ? avail - 3 : 0;
+    }
+    if (safe > 0 && !on_data(p, safe)) {
+        return fail("error al escribir la entrada " + entry.name);
+    }
+    pos += safe;
+    consumed += safe;
+    return true;
+}
+
+bool ZipStreamReader::finish() {
+    if (state == State::Done) return true;
+    if (state != State::Failed) {
+        fail("el archivo ZIP terminó antes de tiempo");
+    }
+    return false;
+}
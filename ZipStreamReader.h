@@ -0,0 +1,65 @@
+#ifndef ZIP_STREAM_READER_H
+#define ZIP_STREAM_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Entrada de un ZIP tal como la describe su cabecera local. Si 'descriptor' es true el CRC y
+// los tamaños no estaban en la cabecera: llegan en el descriptor de datos, con la entrada ya
+// leída, y se rellenan antes de llamar a EntryEnd.
+struct ZipStreamEntry {
+    std::string name;
+    uint16_t method = 0;
+    uint32_t crc = 0;
+    uint64_t compressed_size = 0;
+    uint64_t size = 0;
+    bool zip64 = false;
+    bool descriptor = false;
+};
+
+// Lector de ZIP hacia adelante: recorre las cabeceras locales a medida que llegan los bytes
+// (por ejemplo, desde una descarga) sin necesitar el directorio central del final. Entrega los
+// datos comprimidos de cada entrada; descomprimirlos queda a cargo de quien lo usa.
+//
+// Las entradas con descriptor de datos (las que ZipWriter escribe por partes) terminan donde
+// aparece la firma del descriptor con un tamaño comprimido igual a los bytes leídos. Por eso
+// el descriptor debe llevar firma, como los que escribe ZipWriter.
+class ZipStreamReader {
+public:
+    using EntryBegin = std::function<bool(const ZipStreamEntry& entry)>;
+    using EntryData = std::function<bool(const unsigned char* data, size_t len)>;
+    using EntryEnd = std::function<bool(const ZipStreamEntry& entry)>;
+
+    ZipStreamReader(EntryBegin on_begin, EntryData on_data, EntryEnd on_end);
+
+    // Procesa los siguientes bytes del ZIP. Devuelve false si el archivo está mal formado o
+    // un callback devolvió false; error() explica el motivo.
+    bool feed(const void* data, size_t len);
+    // Indica si se leyeron todas las entradas (se llegó al directorio central).
+    bool finish();
+    const std::string& error() const { return message; }
+
+private:
+    enum class State { Header, Data, Done, Failed };
+
+    bool parse_header();
+    bool parse_data();
+    bool fail(const std::string& text);
+    size_t available() const { return pending.size() - pos; }
+
+    EntryBegin on_begin;
+    EntryData on_data;
+    EntryEnd on_end;
+
+    State state = State::Header;
+    std::vector<unsigned char> pending; // Bytes recibidos y todavía sin procesar (desde 'pos')
+    size_t pos = 0;
+    ZipStreamEntry entry;
+    uint64_t consumed = 0;  // Bytes de datos de la entrada actual ya entregados
+    std::string message;
+};
+
+#endif // ZIP_STREAM_READER_H
@@ -0,0 +1,317 @@
+#include "ZipWriter.h"
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+#include <unistd.h>
+
+// Valores a partir de los cuales un campo no cabe en 16/32 bits y hay que usar ZIP64.
+static constexpr uint64_t ZIP32_MAX = 0xFFFFFFFFull;
+static constexpr uint64_t ZIP16_MAX = 0xFFFFull;
+
+// Tamaño del buffer de escritura (del FILE* o del sink).
+static constexpr size_t SINK_BUFFER_SIZE = 1 << 20;
+
+static void put16(std::vector<unsigned char>& buf, uint16_t v) {
+    buf.push_back(v & 0xFF);
+    buf.push_back((v >> 8) & 0xFF);
+}
+
+static void put32(std::vector<unsigned char>& buf, uint32_t v) {
+    for (int i = 0; i < 4; ++i) buf.push_back((v >> (8 * i)) & 0xFF);
+}
+
+static void put64(std::vector<unsigned char>& buf, uint64_t v) {
+    for (int i = 0; i < 8; ++i) buf.push_back((v >> (8 * i)) & 0xFF);
+}
+
+void to_dos_time(time_t t, uint16_t& dos_time, uint16_t& dos_date) {
+    struct tm tm_local;
+    localtime_r(&t, &tm_local);
+    if (tm_local.tm_year < 80) { // El formato DOS empieza en 1980
+        dos_time = 0;
+        dos_date = (1 << 5) | 1;
+        return;
+    }
+    dos_time = (tm_local.tm_hour << 11) | (tm_local.tm_min << 5) | (tm_local.tm_sec / 2);
+    dos_date = ((tm_local.tm_year - 80) << 9) | ((tm_local.tm_mon + 1) << 5) | tm_local.tm_mday;
+}
+
+ZipWriter::~ZipWriter() {
+    if (opened) {
+        discard();
+    }
+}
+
+bool ZipWriter::open(const fs::path& path) {
+    final_path = path;
+    temp_path = path.string() + ".tmp";
+    file = fopen(temp_path.string().c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error creando archivo ZIP: " << temp_path << std::endl;
+        return false;
+    }
+    // Buffer grande para que las escrituras de entradas pequeñas no sean una syscall cada una.
+    setvbuf(file, nullptr, _IOFBF, SINK_BUFFER_SIZE);
+    opened = true;
+    offset = 0;
+    failed = false;
+    central.clear();
+    return true;
+}
+
+bool ZipWriter::open(const ZipSink& output) {
+    sink = output;
+    sink_buffer.clear();
+    sink_buffer.reserve(SINK_BUFFER_SIZE);
+    opened = true;
+    offset = 0;
+    failed = false;
+    central.clear();
+    return true;
+}
+
+bool ZipWriter::write(const void* data, size_t len) {
+    if (failed) return false;
+    bool ok = true;
+    if (file) {
+        ok = len == 0 || fwrite(data, 1, len, file) == len;
+    } else {
+        // Igual que con setvbuf: las cabeceras y entradas pequeñas se juntan antes de entregarlas.
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        if (sink_buffer.size() + len > SINK_BUFFER_SIZE) {
+            ok = flush_sink();
+        }
+        if (ok && len >= SINK_BUFFER_SIZE) {
+            ok = sink(bytes, len);
+        } else if (ok) {
+            sink_buffer.insert(sink_buffer.end(), bytes, bytes + len);
+        }
+    }
+    if (!ok) {
+        std::cerr << "Error escribiendo en el archivo ZIP." << std::endl;
+        failed = true;
+        return false;
+    }
+    offset += len;
+    return true;
+}
+
+bool ZipWriter::flush_sink() {
+    bool ok = sink_buffer.empty() || sink(sink_buffer.data(), sink_buffer.size());
+    sink_buffer.clear();
+    return ok;
+}
+
+bool ZipWriter::add(const ZipEntry& entry) {
+    if (!opened || failed) return false;
+
+    uint64_t compressed_size = entry.data.size();
+    bool zip64 = entry.size >= ZIP32_MAX || compressed_size >= ZIP32_MAX;
+
+    std::vector<unsigned char> header;
+    put32(header, 0x04034b50);
+    put16(header, zip64 ? 45 : 20);  // Versión necesaria para extraer
+    put16(header, 0x0800);           // Nombres en UTF-8
+    put16(header, entry.method);
+    put16(header, entry.dos_time);
+    put16(header, entry.dos_date);
+    put32(header, entry.crc);
+    put32(header, zip64 ? ZIP32_MAX : compressed_size);
+    put32(header, zip64 ? ZIP32_MAX : entry.size);
+    put16(header, entry.name.size());
+    put16(header, zip64 ? 20 : 0);
+    header.insert(header.end(), entry.name.begin(), entry.name.end());
+    if (zip64) {
+        // En la cabecera local el extra ZIP64 lleva siempre ambos tamaños.
+        put16(header, 0x0001);
+        put16(header, 16);
+        put64(header, entry.size);
+        put64(header, compressed_size);
+    }
+
+    uint64_t header_offset = offset;
+    if (!write(header.data(), header.size()) || !write(entry.data.data(), entry.data.size())) {
+        return false;
+    }
+
+    central.push_back({entry.name, entry.method, 0x0800, entry.crc, entry.size, compressed_size,
+                       header_offset, entry.mode, entry.dos_time, entry.dos_date});
+    return true;
+}
+
+bool ZipWriter::begin_entry(const ZipEntry& meta, bool zip64) {
+    if (!opened || failed || streaming) return false;
+
+    // Bit 3: CRC y tamaños van en el descriptor de datos que sigue a los datos.
+    const uint16_t flags = 0x0800 | 0x0008;
+    std::vector<unsigned char> header;
+    put32(header, 0x04034b50);
+    put16(header, zip64 ? 45 : 20);
+    put16(header, flags);
+    put16(header, meta.method);
+    put16(header, meta.dos_time);
+    put16(header, meta.dos_date);
+    put32(header, 0);
+    put32(header, zip64 ? ZIP32_MAX : 0);
+    put32(header, zip64 ? ZIP32_MAX : 0);
+    put16(header, meta.name.size());
+    put16(header, zip64 ? 20 : 0);
+    header.insert(header.end(), meta.name.begin(), meta.name.end());
+    if (zip64) {
+        // Los tamaños reales van en el descriptor de datos de 64 bits.
+        put16(header, 0x0001);
+        put16(header, 16);
+        put64(header, 0);
+        put64(header, 0);
+    }
+
+    uint64_t header_offset = offset;
+    if (!write(header.data(), header.size())) {
+        return false;
+    }
+    central.push_back({meta.name, meta.method, flags, 0, 0, 0,
+                       header_offset, meta.mode, meta.dos_time, meta.dos_date});
+    streaming = true;
+    streaming_zip64 = zip64;
+    streaming_data_start = offset;
+    return true;
+}
+
+bool ZipWriter::write_data(const void* data, size_t len) {
+    return streaming && write(data, len);
+}
+
+bool ZipWriter::end_entry(uint32_t crc, uint64_t size) {
+    if (!streaming) return false;
+    streaming = false;
+
+    uint64_t compressed_size = offset - streaming_data_start;
+    if (!streaming_zip64 && (size >= ZIP32_MAX || compressed_size >= ZIP32_MAX)) {
+        std::cerr << "Error: la entrada " << central.back().name << " superó el tamaño previsto." << std::endl;
+        failed = true;
+        return false;
+    }
+
+    std::vector<unsigned char> descriptor;
+    put32(descriptor, 0x08074b50);
+    put32(descriptor, crc);
+    if (streaming_zip64) {
+        put64(descriptor, compressed_size);
+        put64(descriptor, size);
+    } else {
+        put32(descriptor, compressed_size);
+        put32(descriptor, size);
+    }
+
+    CentralRecord& rec = central.back();
+    rec.crc = crc;
+    rec.size = size;
+    rec.compressed_size = compressed_size;
+    return write(descriptor.data(), descriptor.size());
+}
+
+bool ZipWriter::close(const std::string& comment) {
+    if (!opened) return false;
+
+    uint64_t central_offset = offset;
+    std::vector<unsigned char> buf;
+    for (const auto& rec : central) {
+        buf.clear();
+        // En el directorio central solo van al extra ZIP64 los campos que no caben.
+        std::vector<unsigned char> extra;
+        if (rec.size >= ZIP32_MAX) put64(extra, rec.size);
+        if (rec.compressed_size >= ZIP32_MAX) put64(extra, rec.compressed_size);
+        if (rec.offset >= ZIP32_MAX) put64(extra, rec.offset);
+        bool zip64 = !extra.empty();
+
+        put32(buf, 0x02014b50);
+        put16(buf, (3 << 8) | 45);       // Creado en unix, versión 4.5
+        put16(buf, zip64 ? 45 : 20);
+        put16(buf, rec.flags);
+        put16(buf, rec.method);
+        put16(buf, rec.dos_time);
+        put16(buf, rec.dos_date);
+        put32(buf, rec.crc);
+        put32(buf, rec.compressed_size >= ZIP32_MAX ? ZIP32_MAX : rec.compressed_size);
+        put32(buf, rec.size >= ZIP32_MAX ? ZIP32_MAX : rec.size);
+        put16(buf, rec.name.size());
+        put16(buf, zip64 ? extra.size() + 4 : 0);
+        put16(buf, 0);                   // Comentario
+        put16(buf, 0);                   // Disco de inicio
+        put16(buf, 0);                   // Atributos internos
+        put32(buf, rec.mode << 16);      // Atributos externos: permisos unix
+        put32(buf, rec.offset >= ZIP32_MAX ? ZIP32_MAX : rec.offset);
+        buf.insert(buf.end(), rec.name.begin(), rec.name.end());
+        if (zip64) {
+            put16(buf, 0x0001);
+            put16(buf, extra.size());
+            buf.insert(buf.end(), extra.begin(), extra.end());
+        }
+        write(buf.data(), buf.size());
+    }
+    uint64_t central_size = offset - central_offset;
+    uint64_t entries = central.size();
+
+    buf.clear();
+    if (entries >= ZIP16_MAX || central_size >= ZIP32_MAX || central_offset >= ZIP32_MAX) {
+        uint64_t zip64_eocd_offset = offset;
+        put32(buf, 0x06064b50);          // Fin de directorio central ZIP64
+        put64(buf, 44);
+        put16(buf, (3 << 8) | 45);
+        put16(buf, 45);
+        put32(buf, 0);
+        put32(buf, 0);
+        put64(buf, entries);
+        put64(buf, entries);
+        put64(buf, central_size);
+        put64(buf, central_offset);
+        put32(buf, 0x07064b50);          // Localizador ZIP64
+        put32(buf, 0);
+        put64(buf, zip64_eocd_offset);
+        put32(buf, 1);
+    }
+    put32(buf, 0x06054b50);
+    put16(buf, 0);
+    put16(buf, 0);
+    put16(buf, entries >= ZIP16_MAX ? ZIP16_MAX : entries);
+    put16(buf, entries >= ZIP16_MAX ? ZIP16_MAX : entries);
+    put32(buf, central_size >= ZIP32_MAX ? ZIP32_MAX : central_size);
+    size_t comment_len = std::min<size_t>(comment.size(), ZIP16_MAX);
+    put32(buf, central_offset >= ZIP32_MAX ? ZIP32_MAX : central_offset);
+    put16(buf, comment_len);
+    buf.insert(buf.end(), comment.begin(), comment.begin() + comment_len);
+    write(buf.data(), buf.size());
+
+    if (!file) {
+        bool ok = !failed && flush_sink();
+        if (!ok) {
+            std::cerr << "Error cerrando el archivo ZIP." << std::endl;
+        }
+        opened = false;
+        return ok;
+    }
+
+    // El ZIP anterior solo se reemplaza cuando el nuevo está completo en disco.
+    bool ok = !failed && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0) ok = false;
+    file = nullptr;
+    opened = false;
+    std::error_code ec;
+    if (ok) {
+        fs::rename(temp_path, final_path, ec);
+        if (!ec) return true;
+    }
+    std::cerr << "Error cerrando el archivo ZIP." << std::endl;
+    fs::remove(temp_path, ec);
+    return false;
+}
+
+void ZipWriter::discard() {
+    if (!opened) return;
+    opened = false;
+    if (!file) return;
+    fclose(file);
+    file = nullptr;
+    std::error_code ec;
+    fs::remove(temp_path, ec);
+}
@@ -0,0 +1,89 @@
+#ifndef ZIP_WRITER_H
+#define ZIP_WRITER_H
+
+#include "Codec.h"
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Entrada ya comprimida, lista para escribirse en el ZIP.
+struct ZipEntry {
+    std::string name;              // Ruta dentro del ZIP (con '/')
+    uint16_t method = ZIP_METHOD_STORE;
+    uint32_t crc = 0;              // CRC-32 de los datos sin comprimir
+    uint64_t size = 0;             // Tamaño sin comprimir
+    uint32_t mode = 0;             // Permisos unix (st_mode)
+    uint16_t dos_time = 0;
+    uint16_t dos_date = 0;
+    std::vector<unsigned char> data; // Datos comprimidos
+};
+
+// Recibe los bytes del ZIP en orden; devuelve false para cancelar la escritura.
+using ZipSink = std::function<bool(const void* data, size_t len)>;
+
+// Escritor secuencial de archivos ZIP (con ZIP64 cuando hace falta).
+// Solo escribe hacia adelante: cabecera local + datos por entrada y el directorio central al cerrar.
+class ZipWriter {
+public:
+    ~ZipWriter();
+    // Escribe en '<path>.tmp' y lo renombra a 'path' en close(), así un respaldo que falla
+    // a medias no destruye el ZIP anterior.
+    bool open(const fs::path& path);
+    // Escribe el ZIP en 'sink' en lugar de un archivo (por ejemplo, para subirlo mientras se crea).
+    // Funciona porque el escritor nunca vuelve atrás.
+    bool open(const ZipSink& sink);
+    bool add(const ZipEntry& entry);
+    // 'comment' se guarda como comentario del ZIP (metadatos del respaldo).
+    bool close(const std::string& comment = "");
+    // Abandona el ZIP sin cerrarlo: borra el archivo temporal y deja intacto el anterior.
+    void discard();
+
+    // Entradas cuyos datos se escriben por partes (archivos grandes comprimidos por bloques).
+    // El CRC y los tamaños no se conocen al escribir la cabecera local, así que se escriben
+    // después de los datos en un descriptor de datos. 'meta.data' se ignora.
+    bool begin_entry(const ZipEntry& meta, bool zip64);
+    bool write_data(const void* data, size_t len);
+    bool end_entry(uint32_t crc, uint64_t size);
+
+private:
+    struct CentralRecord {
+        std::string name;
+        uint16_t method;
+        uint16_t flags;
+        uint32_t crc;
+        uint64_t size;
+        uint64_t compressed_size;
+        uint64_t offset;
+        uint32_t mode;
+        uint16_t dos_time;
+        uint16_t dos_date;
+    };
+
+    bool write(const void* data, size_t len);
+    bool flush_sink();
+
+    FILE* file = nullptr;
+    fs::path final_path;
+    fs::path temp_path;
+    ZipSink sink;
+    std::vector<unsigned char> sink_buffer;
+    bool opened = false;
+    uint64_t offset = 0;
+    bool failed = false;
+    std::vector<CentralRecord> central;
+
+    // Estado de la entrada que se está escribiendo por partes
+    bool streaming = false;
+    bool streaming_zip64 = false;
+    uint64_t streaming_data_start = 0;
+};
+
+// Convierte una marca de tiempo unix a los campos de hora y fecha de MS-DOS que usa ZIP.
+void to_dos_time(time_t t, uint16_t& dos_time, uint16_t& dos_date);
+
+#endif // ZIP_WRITER_H
@@ -1,7 +1,8 @@
 #include "StorageHandler.h"
 #include "utils.h"
 #include <iostream>
-#include <curl/curl.h>
+#include "ConnectionPool.h" // cURL y el pool de conexiones de todo el proceso
+#include "SystemLimits.h" // Recursos del contenedor y ajuste de hilos, E/S y memoria
 
 // Función para elegir la acción (Respaldo o Restauración)
 std::string choose_action() {
@@ -20,12 +21,17 @@ std::string choose_action() {
 
 int main() {
     
-    curl_global_init(CURL_GLOBAL_ALL);
+    // Inicializa cURL para todo el proceso; al salir de main cierra el pool de conexiones
+    // y llama a curl_global_cleanup, sea cual sea el return.
+    CurlGlobal curl_global;
+
+    // Los hilos, la E/S en vuelo y el presupuesto de memoria salen de la cuota de CPU y del
+    // límite de memoria del cgroup, no de la máquina entera.
+    std::cout << describe_tuning() << std::endl;
 
     std::string action = choose_action();
     if (action.empty()) {
         show_message("No se seleccionó ninguna acción.");
-        curl_global_cleanup(); // Limpia cURL si se inicializó globalmente
         return 1;
     }
 
@@ -35,67 +41,56 @@ int main() {
         auto folders = select_folders();
         if (folders.empty()) {
             show_message("No se seleccionaron carpetas.");
-            curl_global_cleanup();
             return 1;
         }
 
         std::string dest_type = choose_destination_type();
         if (dest_type.empty()) {
             show_message("No se seleccionó el tipo de destino.");
-            curl_global_cleanup();
             return 1;
         }
 
         storage_handler = createStorageHandler(dest_type);
         if (!storage_handler) {
             show_message("Tipo de almacenamiento no válido.");
-            curl_global_cleanup();
             return 1;
         }
 
         if (!storage_handler->validate()) {
-             curl_global_cleanup();
             return 1;
         }
 
         if (!storage_handler->backup(folders)) {
             show_message("Error durante el proceso de respaldo.");
-            curl_global_cleanup();
             return 1;
         }
     } else if (action == "Restaurar") {
         std::string restore_type = choose_destination_type(); // Pregunta al usuario el tipo de almacenamiento para restaurar
         if (restore_type.empty()) {
             show_message("No se seleccionó el tipo de almacenamiento para restaurar.");
-            curl_global_cleanup();
             return 1;
         }
 
         storage_handler = createStorageHandler(restore_type);
         if (!storage_handler) {
             show_message("Tipo de almacenamiento no válido para restauración.");
-            curl_global_cleanup();
             return 1;
         }
 
         if (!storage_handler->validate()) {
             // La validación para restauración podría ser diferente poor ej. verificar si el USB está conectado o algo asi
-            curl_global_cleanup();
             return 1;
         }
 
         if (!storage_handler->restore()) {
             show_message("Error durante el proceso de restauración.");
-            curl_global_cleanup();
             return 1;
         }
     } else {
         show_message("Acción no reconocida.");
-        curl_global_cleanup();
         return 1;
     }
     show_message("Operación completada exitosamente.");
-    curl_global_cleanup();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,213 @@
+// Microbenchmark de las colas entre etapas del pipeline: MpmcQueue (anillo sin locks de
+// Pipeline.h) frente a una cola con mutex y variable de condición, la que usaba el pipeline
+// antes. Cada productor mete ITEMS_PER_PRODUCER valores y los consumidores los sacan; la suma
+// de lo sacado comprueba que no se pierde ni se repite nada. Al final, una prueba de las esperas
+// con una cola mínima y pausas en las dos etapas obliga a dormir y despertar una y otra vez.
+//
+// Compilar desde la raíz del proyecto con: make bench_colas
+// Uso: pruebaColas/bench_colas [elementos_por_productor]
+
+#include "../Pipeline.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Cola de referencia: un mutex protege un deque acotado y las esperas van por dos variables de
+// condición.
+template <typename T>
+class MutexQueue {
+public:
+    explicit MutexQueue(size_t capacity) : capacity(capacity) {}
+
+    bool push(T value) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [&] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(value));
+        not_empty.notify_one();
+        return true;
+    }
+
+    bool pop(T& out) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [&] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        out = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    std::deque<T> items;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+};
+
+/**
+ * @brief Pasa producers * items valores por la cola con 'consumers' hilos sacando.
+ *
+ * @return Millones de elementos por segundo, o -1 si la suma no cuadra.
+ */
+template <typename Queue>
+double run(unsigned producers, unsigned consumers, uint64_t items, size_t capacity) {
+    Queue queue(capacity);
+    std::vector<uint64_t> sums(consumers, 0);
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned c = 0; c < consumers; ++c) {
+        threads.emplace_back([&, c] {
+            uint64_t value;
+            uint64_t sum = 0;
+            while (queue.pop(value)) {
+                sum += value;
+            }
+            sums[c] = sum;
+        });
+    }
+    std::vector<std::thread> producer_threads;
+    for (unsigned p = 0; p < producers; ++p) {
+        producer_threads.emplace_back([&, p] {
+            for (uint64_t i = 0; i < items; ++i) {
+                queue.push(p * items + i + 1);
+            }
+        });
+    }
+    for (std::thread& t : producer_threads) t.join();
+    queue.close();
+    for (std::thread& t : threads) t.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t total = producers * items;
+    uint64_t expected = total * (total + 1) / 2;
+    uint64_t sum = 0;
+    for (uint64_t s : sums) sum += s;
+    if (sum != expected) return -1;
+    return total / seconds / 1e6;
+}
+
+/**
+ * @brief Prueba de las esperas de MpmcQueue: capacidad 2 y productores y consumidores que se
+ * paran cada PAUSE_EVERY elementos durante 'pause', más de lo que dura la espera activa, así
+ * que unos y otros acaban dormidos en la variable de condición. Las pausas cortas hacen que la
+ * otra etapa avance justo mientras uno se prepara para dormir. Un aviso perdido o un bloqueo
+ * del mutex dejaría la prueba colgada.
+ *
+ * @return true si la suma cuadra y terminó antes de 'timeout'.
+ */
+bool stress_waits(unsigned producers, unsigned consumers, uint64_t items, std::chrono::microseconds pause,
+                  std::chrono::seconds timeout) {
+    constexpr uint64_t PAUSE_EVERY = 16;
+    std::atomic<bool> done{false};
+    bool sum_ok = false;
+
+    std::thread worker([&] {
+        MpmcQueue<uint64_t> queue(2);
+        std::vector<uint64_t> sums(consumers, 0);
+        std::vector<std::thread> threads;
+        for (unsigned c = 0; c < consumers; ++c) {
+            threads.emplace_back([&, c] {
+                uint64_t value;
+                uint64_t count = 0;
+                while (queue.pop(value)) {
+                    sums[c] += value;
+                    if (++count % PAUSE_EVERY == 0) std::this_thread::sleep_for(pause);
+                }
+            });
+        }
+        std::vector<std::thread> producer_threads;
+        for (unsigned p = 0; p < producers; ++p) {
+            producer_threads.emplace_back([&, p] {
+                for (uint64_t i = 0; i < items; ++i) {
+                    queue.push(p * items + i + 1);
+                    // Desfasados de los consumidores para que las dos etapas se esperen.
+                    if ((i + PAUSE_EVERY / 2) % PAUSE_EVERY == 0) std::this_thread::sleep_for(pause);
+                }
+            });
+        }
+        for (std::thread& t : producer_threads) t.join();
+        queue.close();
+        for (std::thread& t : threads) t.join();
+
+        uint64_t total = producers * items;
+        uint64_t sum = 0;
+        for (uint64_t s : sums) sum += s;
+        sum_ok = sum == total * (total + 1) / 2;
+        done.store(true);
+    });
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done.load() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (!done.load()) {
+        // Los hilos colgados no se pueden unir: se informa y se sale sin esperarlos.
+        std::cerr << "Error: la cola se quedó bloqueada en la prueba de esperas." << std::endl;
+        std::_Exit(1);
+    }
+    worker.join();
+    return sum_ok;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t items = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    if (items == 0) {
+        std::cerr << "Uso: " << argv[0] << " [elementos_por_productor]" << std::endl;
+        return 1;
+    }
+
+    struct Case {
+        unsigned producers;
+        unsigned consumers;
+        size_t capacity;
+    };
+    const Case cases[] = {{1, 1, 64}, {1, 4, 64}, {4, 1, 64}, {4, 4, 64}, {4, 4, 1024}, {8, 8, 1024}};
+
+    std::cout << "Elementos por productor: " << items << " (" << std::thread::hardware_concurrency()
+              << " núcleos)\n";
+    std::cout << "prod cons  capac.   mutex (Mop/s)   sin locks (Mop/s)\n";
+    std::cout << std::fixed << std::setprecision(2);
+    bool ok = true;
+    for (const Case& c : cases) {
+        double locked = run<MutexQueue<uint64_t>>(c.producers, c.consumers, items, c.capacity);
+        double lock_free = run<MpmcQueue<uint64_t>>(c.producers, c.consumers, items, c.capacity);
+        ok = ok && locked >= 0 && lock_free >= 0;
+        std::cout << std::setw(4) << c.producers << std::setw(5) << c.consumers << std::setw(8) << c.capacity
+                  << std::setw(16) << locked << std::setw(20) << lock_free << "\n";
+    }
+
+    const unsigned stress_threads = 4;
+    const uint64_t stress_items = 20000;
+    bool waits_ok = true;
+    for (long pause_us : {5, 10, 20, 50, 100, 1000}) {
+        std::chrono::microseconds pause(pause_us);
+        waits_ok = stress_waits(stress_threads, stress_threads, stress_items, pause, std::chrono::seconds(30)) &&
+                   waits_ok;
+    }
+    std::cout << "Esperas (" << stress_threads << " prod, " << stress_threads << " cons, capacidad 2, "
+              << stress_items << " por productor, pausas de 5 us a 1 ms): " << (waits_ok ? "bien" : "ERROR")
+              << "\n";
+    ok = ok && waits_ok;
+    if (!ok) {
+        std::cerr << "Error: alguna cola perdió o repitió elementos." << std::endl;
+        return 1;
+    }
+    return 0;
+}
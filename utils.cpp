@@ -1,20 +1,30 @@
 #include "utils.h"
+#include "Chunker.h" // sha256_hex para nombrar las firmas
+#include "Delta.h"
+#include "IoEngine.h"
+#include "Scheduler.h"
+#include "ZipStreamReader.h"
 #include <iostream>
 #include <sstream>
 #include <cstdlib>
-#include <zip.h> // Para compresión y descompresión ZIP
+#include <zip.h> // Para leer los archivos ZIP en la restauración
+#include <zlib.h> // Para verificar el CRC-32 de lo restaurado
 #include <algorithm>
-#include <execution> // Para std::for_each con paralelismo
-#include <mutex>
+#include <atomic>
 #include <string>
 #include <vector>
 #include <filesystem>
-#include <fstream> // Para std::ofstream en descompresión
 #include <cstring> // ¡Añadido para strlen!
-#include <omp.h>
+#include <memory>
+#include <unordered_set>
+#include <ctime>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
 
 
 namespace fs = std::filesystem;
+using json = nlohmann::json;
 
 void show_message(const std::string& message) {
     std::string cmd = "zenity --info --text=\"" + message + "\"";
@@ -46,7 +56,7 @@ std::vector<std::string> select_folders() {
 }
 
 std::string choose_destination_type() {
-    FILE* fp = popen("zenity --list --radiolist --title=\"Tipo de almacenamiento\" \\\n                     --column=\"\" --column=\"Opcion\" \\\n                     TRUE Local \\\n                     FALSE Nube \\\n                     FALSE USB", "r");
+    FILE* fp = popen("zenity --list --radiolist --title=\"Tipo de almacenamiento\" \\\n                     --column=\"\" --column=\"Opcion\" \\\n                     TRUE Local \\\n                     FALSE Nube \\\n                     FALSE USB \\\n                     FALSE Repositorio", "r");
     if (!fp) return "";
     char buffer[256];
     std::string choice;
@@ -58,52 +68,381 @@ std::string choose_destination_type() {
     return choice;
 }
 
-bool copy_directory(const fs::path& source, const fs::path& destination) {
-    try {
-        if (!fs::exists(source) || !fs::is_directory(source)) {
-            return false;
-        }
-        
-        fs::copy(source, destination, 
-                 fs::copy_options::recursive | 
-                 fs::copy_options::overwrite_existing);
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "Error copiando directorio: " << e.what() << std::endl;
+bool copy_directory(const fs::path& source, const fs::path& destination, CopyReport* report) {
+    std::error_code ec;
+    if (!fs::is_directory(source, ec)) {
         return false;
     }
+    CopyReport local;
+    return copy_tree(source, destination, report ? *report : local);
+}
+
+// Añade a 'items' todos los archivos regulares de 'folder', nombrándolos como 'prefix/ruta_relativa'.
+// Los archivos se leerán desde su ubicación original: no hay copia intermedia. El recorrido es
+// paralelo (scan_tree) y cada archivo trae ya su stat. Quedan en el orden en que conviene
+// leerlos según el disco de la carpeta (choose_read_schedule).
+static void collect_folder_items(const fs::path& folder, const fs::path& prefix, std::vector<ArchiveItem>& items,
+                                 ScanStats* scan = nullptr) {
+    std::string base = prefix.empty() ? std::string() : prefix.generic_string() + "/";
+    ScanStats folder_scan;
+    std::vector<FileRecord> records = scan_tree(folder, &folder_scan);
+    ReadSchedule schedule = choose_read_schedule(folder);
+    folder_scan.order = sort_for_reading(records, schedule.order);
+    folder_scan.readers = schedule.readers;
+    for (FileRecord& record : records) {
+        ArchiveItem item;
+        item.source = std::move(record.path);
+        item.name = base + record.relative;
+        item.scanned = true;
+        item.size = record.size;
+        item.mode = record.mode;
+        item.mtime_ns = record.mtime_ns;
+        item.inode = record.inode;
+        items.push_back(std::move(item));
+    }
+    if (scan) {
+        add_scan_stats(*scan, folder_scan);
+    }
 }
 
 void compress_folder(const fs::path& folder, const fs::path& dest_path) {
-    std::string zipname = dest_path.string() + ".zip";
-    int err = 0;
-    zip_t* archive = zip_open(zipname.c_str(), ZIP_CREATE | ZIP_TRUNCATE, &err);
-    if (!archive) {
+    fs::path zipname = dest_path.string() + ".zip";
+    std::vector<ArchiveItem> items;
+    collect_folder_items(folder, fs::path(), items);
+    if (!write_archive(items, zipname, CodecOptions())) {
         std::cerr << "Error creando archivo ZIP: " << zipname << std::endl;
-        return;
+    }
+}
+
+std::vector<ArchiveItem> collect_backup_items(const std::vector<std::string>& folders,
+                                              std::vector<std::string>* roots, ScanStats* scan) {
+    // Cada carpeta queda bajo su propio nombre dentro del respaldo, igual que cuando se copiaba
+    // a la carpeta de respaldo. Si dos carpetas se llaman igual se añade un sufijo.
+    std::vector<ArchiveItem> items;
+    std::vector<std::string> used_names;
+    for (const auto& folder : folders) {
+        fs::path source_path(folder);
+        std::string name = source_path.filename().string();
+        if (name.empty()) {
+            name = source_path.parent_path().filename().string(); // Rutas terminadas en '/'
+        }
+        std::string unique_name = name;
+        for (int n = 2; std::find(used_names.begin(), used_names.end(), unique_name) != used_names.end(); ++n) {
+            unique_name = name + "_" + std::to_string(n);
+        }
+        used_names.push_back(unique_name);
+
+        collect_folder_items(source_path, unique_name, items, scan);
+    }
+    if (roots) {
+        *roots = used_names;
+    }
+    return items;
+}
+
+// Entrada con los metadatos de un respaldo incremental (lista de archivos borrados).
+// No se extrae como un archivo más: decompress_file la aplica al restaurar.
+static const std::string INCREMENTAL_METADATA_ENTRY = ".backup_tool/incremental.json";
+
+static bool is_under_roots(const std::string& path, const std::vector<std::string>& roots) {
+    for (const auto& root : roots) {
+        if (path.size() > root.size() && path.compare(0, root.size(), root) == 0 && path[root.size()] == '/') {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Prefijo de las entradas con el delta de un archivo grande modificado.
+static const std::string DELTA_ENTRY_PREFIX = ".backup_tool/delta/";
+
+// Bytes que decompress_stream pide a la fuente en cada lectura.
+static constexpr size_t STREAM_READ_SIZE = 1 << 20;
+// Bytes comprimidos que extract_entry lee de cada entrada por llamada a zip_fread.
+static constexpr size_t EXTRACT_READ_SIZE = 256 * 1024;
+// Escritura de lo restaurado a través del IoEngine: buffers de cada archivo en vuelo a la vez.
+static constexpr size_t RESTORE_WRITE_BUFFER_SIZE = 256 * 1024;
+static constexpr unsigned RESTORE_WRITE_BUFFERS = 8;
+
+// Una firma por archivo grande, nombrada por el SHA-256 de su ruta dentro del respaldo.
+static fs::path signature_path(const IncrementalState& state, const std::string& name) {
+    return state.signature_dir /
+           (sha256_hex(reinterpret_cast<const unsigned char*>(name.data()), name.size()) + ".sig");
+}
+
+struct DeltaPlan {
+    bool use_delta = false;
+    fs::path delta_path;
+    DeltaResult result;
+};
+
+// Para cada archivo grande modificado calcula su firma nueva (queda pendiente hasta
+// commit_incremental) y, si hay firma de la versión respaldada antes, escribe el delta en
+// 'delta_dir'. Si el delta no ahorra al menos la mitad del archivo se respalda entero.
+static std::vector<DeltaPlan> plan_deltas(const std::vector<ArchiveItem>& items,
+                                          const std::vector<FileState>& current,
+                                          const std::vector<size_t>& changed_index,
+                                          IncrementalState& state, const fs::path& delta_dir) {
+    std::vector<DeltaPlan> plans(changed_index.size());
+    std::vector<size_t> large;
+    for (size_t k = 0; k < changed_index.size(); ++k) {
+        if (current[changed_index[k]].size >= DELTA_MIN_FILE_SIZE) {
+            large.push_back(k);
+        }
+    }
+    if (large.empty()) {
+        return plans;
+    }
+    std::error_code ec;
+    fs::create_directories(state.signature_dir, ec);
+    fs::create_directories(delta_dir, ec);
+
+    std::vector<fs::path> pending(changed_index.size());
+    parallel_for(Lane::Cpu, large.size(), [&](size_t n) {
+        size_t k = large[n];
+        const ArchiveItem& item = items[changed_index[k]];
+        fs::path final_path = signature_path(state, item.name);
+
+        FileState previous;
+        FileSignature basis;
+        FileSignature signature;
+        bool signed_by_delta = false; // write_delta ya calculó la firma nueva
+        if (state.incremental && state.previous.find(item.name, previous) && load_signature(final_path, basis) &&
+            basis.file_size == previous.size && basis.crc == previous.crc) {
+            DeltaPlan& plan = plans[k];
+            plan.delta_path = delta_dir / (std::to_string(k) + ".delta");
+            signed_by_delta = write_delta(item.source, basis, plan.delta_path, plan.result, &signature);
+            plan.use_delta = signed_by_delta && plan.result.literal_bytes <= current[changed_index[k]].size / 2;
+        }
+
+        fs::path new_path = final_path.string() + ".new";
+        if ((signed_by_delta || compute_signature(item.source, signature)) && save_signature(new_path, signature)) {
+            pending[k] = new_path;
+        }
+    });
+    for (const auto& path : pending) {
+        if (!path.empty()) {
+            state.pending_signatures.push_back(path);
+        }
+    }
+    return plans;
+}
+
+bool compress_folders(const std::vector<std::string>& folders, const ArchiveOutput& output,
+                      const CodecOptions& codec, BackupStats* stats, IncrementalState* incremental) {
+    std::vector<ArchiveItem> items;
+    std::vector<std::string> roots;
+    ScanStats scan;
+    try {
+        items = collect_backup_items(folders, &roots, &scan);
+    } catch (const std::exception& e) {
+        std::cerr << "Error recorriendo las carpetas a comprimir: " << e.what() << std::endl;
+        return false;
+    }
+    // Muestra de la caché antes de leer nada (las firmas de los incrementales también leen).
+    CacheSampler sampler;
+    for (size_t i = 0; i < items.size(); ++i) {
+        sampler.before_read(items[i].source, i);
+    }
+    auto add_source_stats = [&]() {
+        if (stats) {
+            stats->scan_files = scan.files;
+            stats->scan_directories = scan.directories;
+            stats->scan_syscalls = scan.syscalls;
+            stats->scan_uring = scan.uring;
+            stats->scan_order = read_order_name(scan.order);
+            stats->scan_readers = scan.readers;
+            sampler.finish(stats->cache);
+        }
+    };
+
+    // En un disco rotacional se lee en el orden de 'items' con pocas lecturas a la vez; si no,
+    // con todas las que admite el anillo.
+    set_io_queue_depth(scan.readers > 0 ? scan.readers : IO_QUEUE_DEPTH);
+    struct DepthReset {
+        ~DepthReset() { set_io_queue_depth(0); }
+    } depth_reset;
+
+    if (!incremental) {
+        bool ok = write_archive(items, output, codec, stats);
+        add_source_stats();
+        return ok;
     }
 
-    std::vector<fs::path> files;
-    for (auto& entry : fs::recursive_directory_iterator(folder)) {
-        if (fs::is_regular_file(entry)) {
-            files.push_back(entry.path());
+    // Comparar cada archivo con su estado en el respaldo anterior (tamaño, mtime e inodo).
+    std::vector<FileState> current(items.size());
+    std::vector<size_t> changed_index;
+    std::unordered_set<std::string> current_paths;
+    for (size_t i = 0; i < items.size(); ++i) {
+        // collect_backup_items ya trae el stat de cada archivo.
+        current[i] = {items[i].name, items[i].size, items[i].mtime_ns, items[i].inode, 0};
+        current_paths.insert(items[i].name);
+
+        FileState previous;
+        if (incremental->incremental && incremental->previous.find(items[i].name, previous) &&
+            previous.size == current[i].size && previous.mtime_ns == current[i].mtime_ns &&
+            previous.inode == current[i].inode) {
+            current[i].crc = previous.crc; // Sin cambios: no se vuelve a leer
+            continue;
+        }
+        changed_index.push_back(i);
+    }
+
+    // Archivos grandes modificados: se guarda solo el delta respecto a la versión anterior.
+    fs::path delta_dir = fs::temp_directory_path() / ("backup_tool_delta_" + std::to_string(getpid()));
+    std::vector<DeltaPlan> plans = plan_deltas(items, current, changed_index, *incremental, delta_dir);
+
+    std::vector<ArchiveItem> changed;
+    uint64_t delta_files = 0;
+    uint64_t delta_saved = 0;
+    for (size_t k = 0; k < changed_index.size(); ++k) {
+        const ArchiveItem& item = items[changed_index[k]];
+        if (plans[k].use_delta) {
+            changed.push_back({plans[k].delta_path, DELTA_ENTRY_PREFIX + item.name, std::string()});
+            ++delta_files;
+            delta_saved += plans[k].result.copied_bytes;
+        } else {
+            changed.push_back(item);
+        }
+    }
+
+    // Del manifiesto anterior: lo que estaba bajo estas carpetas y ya no existe son borrados;
+    // lo que pertenece a otras carpetas se conserva tal cual.
+    std::vector<FileState> next;
+    json deleted = json::array();
+    for (size_t i = 0; i < incremental->previous.size(); ++i) {
+        FileState previous = incremental->previous.at(i);
+        if (!is_under_roots(previous.path, roots)) {
+            next.push_back(std::move(previous));
+        } else if (!current_paths.count(previous.path)) {
+            deleted.push_back(previous.path);
+            incremental->obsolete_signatures.push_back(signature_path(*incremental, previous.path));
+        }
+    }
+    if (incremental->incremental) {
+        json metadata = {{"type", "incremental"}, {"created", std::time(nullptr)}, {"deleted", deleted}};
+        changed.push_back({fs::path(), INCREMENTAL_METADATA_ENTRY, metadata.dump()});
+        std::cout << "Respaldo incremental: " << changed_index.size() << " archivos nuevos o modificados ("
+                  << delta_files << " como delta, " << delta_saved / (1024 * 1024) << " MB sin cambios no reenviados), "
+                  << deleted.size() << " borrados, " << items.size() - changed_index.size()
+                  << " sin cambios." << std::endl;
+    }
+
+    std::vector<uint32_t> crcs;
+    bool ok = write_archive(changed, output, codec, stats, &crcs);
+    add_source_stats();
+    std::error_code ec;
+    fs::remove_all(delta_dir, ec);
+    if (!ok) {
+        return false;
+    }
+    for (size_t k = 0; k < changed_index.size(); ++k) {
+        // El CRC de una entrada delta es el del delta: el del archivo lo calculó plan_deltas.
+        current[changed_index[k]].crc = plans[k].use_delta ? plans[k].result.crc : crcs[k];
+    }
+    next.insert(next.end(), std::make_move_iterator(current.begin()), std::make_move_iterator(current.end()));
+    incremental->next = std::move(next);
+    return true;
+}
+
+bool commit_incremental(const fs::path& manifest_path, IncrementalState& state) {
+    bool ok = FileManifest::save(manifest_path, std::move(state.next));
+    // Las firmas nuevas solo reemplazan a las anteriores cuando el respaldo quedó confirmado,
+    // para que el próximo delta se calcule contra una versión que realmente está respaldada.
+    std::error_code ec;
+    for (const auto& pending : state.pending_signatures) {
+        fs::rename(pending, fs::path(pending).replace_extension(), ec);
+        ok = ok && !ec;
+    }
+    for (const auto& obsolete : state.obsolete_signatures) {
+        fs::remove(obsolete, ec);
+    }
+    if (!ok) {
+        std::cerr << "Advertencia: no se pudo guardar el manifiesto " << manifest_path << std::endl;
+    }
+    return ok;
+}
+
+BackupMode choose_backup_mode() {
+    FILE* fp = popen("zenity --list --radiolist --title=\"Tipo de respaldo\" \\\n                     --column=\"\" --column=\"Tipo\" \\\n                     TRUE Completo \\\n                     FALSE Incremental", "r");
+    if (!fp) return BackupMode::Full;
+    char buffer[256];
+    std::string choice;
+    if (fgets(buffer, sizeof(buffer), fp)) {
+        choice = buffer;
+        choice.erase(choice.find_last_not_of("\n\r") + 1);
+    }
+    pclose(fp);
+    return choice == "Incremental" ? BackupMode::Incremental : BackupMode::Full;
+}
+
+void prepare_incremental(const fs::path& manifest_path, BackupMode mode, IncrementalState& state) {
+    // Las firmas de los archivos grandes viven junto al manifiesto ('x.manifest' -> 'x.signatures').
+    state.signature_dir = manifest_path.parent_path() / (manifest_path.stem().string() + ".signatures");
+    bool loaded = state.previous.load(manifest_path);
+    state.incremental = mode == BackupMode::Incremental && loaded;
+    if (mode == BackupMode::Incremental && !loaded) {
+        show_message("No hay un respaldo anterior con el que comparar. Se hará un respaldo completo.");
+    }
+}
+
+CodecOptions choose_codec() {
+    CodecOptions options;
+    std::string cmd = "zenity --list --radiolist --title=\"Compresión del respaldo\" "
+                      "--column=\"\" --column=\"Codec\" TRUE deflate";
+    for (CodecType type : {CodecType::Zstd, CodecType::Lz4, CodecType::Store}) {
+        if (codec_available(type)) {
+            cmd += " FALSE " + codec_name(type);
         }
     }
+    FILE* fp = popen(cmd.c_str(), "r");
+    if (!fp) return options;
+    char buffer[256];
+    std::string choice;
+    if (fgets(buffer, sizeof(buffer), fp)) {
+        choice = buffer;
+        choice.erase(choice.find_last_not_of("\n\r") + 1);
+    }
+    pclose(fp);
 
-    std::mutex zip_mutex;
+    // Si se cancela el diálogo se mantiene deflate, el formato de siempre.
+    if (!codec_from_name(choice, options.type)) {
+        return options;
+    }
 
-    std::for_each(std::execution::par_unseq, files.begin(), files.end(),
-        [&](const fs::path& file_path) {
-            std::string relative_path = fs::relative(file_path, folder).string();
-            
-            std::lock_guard<std::mutex> lock(zip_mutex);
-            zip_source_t* source = zip_source_file(archive, file_path.c_str(), 0, 0);
-            if (source != nullptr) {
-                zip_file_add(archive, relative_path.c_str(), source, ZIP_FL_OVERWRITE);
+    if (options.type == CodecType::Zstd) {
+        options.level = 3;
+        fp = popen("zenity --scale --title=\"Nivel de zstd\" --text=\"Nivel de compresión (1 = más rápido, 19 = más compacto)\" "
+                   "--min-value=1 --max-value=19 --value=3", "r");
+        if (fp) {
+            if (fgets(buffer, sizeof(buffer), fp)) {
+                options.level = std::clamp(std::atoi(buffer), 1, 19);
             }
-        });
+            pclose(fp);
+        }
+    }
+    return options;
+}
 
-    zip_close(archive);
+CachePolicy choose_cache_policy() {
+    FILE* fp = popen("zenity --list --radiolist --title=\"Uso de la caché de páginas\" "
+                     "--text=\"Cómo leer los archivos de origen sin desplazar la caché de otros servicios\" "
+                     "--column=\"\" --column=\"Modo\" --column=\"Descripción\" "
+                     "TRUE liberar \"Soltar de la caché lo ya leído\" "
+                     "FALSE directa \"O_DIRECT, sin pasar por la caché\" "
+                     "FALSE normal \"Dejar lo leído en la caché\"", "r");
+    CachePolicy policy = CachePolicy::DropBehind;
+    if (!fp) return policy;
+    char buffer[256];
+    std::string choice;
+    if (fgets(buffer, sizeof(buffer), fp)) {
+        choice = buffer;
+        choice.erase(choice.find_last_not_of("\n\r") + 1);
+    }
+    pclose(fp);
+    // Si se cancela el diálogo se suelta lo leído, que es lo que menos molesta al resto.
+    cache_policy_from_name(choice, policy);
+    return policy;
 }
 
 // --- Implementaciones de las nuevas funciones para la restauración ---
@@ -178,19 +517,155 @@ std::string select_zip_file() {
     return ""; // No se seleccionó ningún archivo o la selección fue inválida
 }
 
-// Función para descomprimir un archivo ZIP
+fs::path safe_relative_path(const std::string& name) {
+    fs::path relative = fs::path(name).lexically_normal();
+    if (relative.is_absolute() || relative.empty() || *relative.begin() == "..") {
+        return fs::path();
+    }
+    return relative;
+}
+
+// Reconstruye 'target' con el delta extraído en 'delta_path' y borra el delta.
+static bool rebuild_from_delta(const fs::path& target, const fs::path& delta_path) {
+    fs::path rebuilt_path = target.string() + ".btdelta.new";
+    std::error_code ec;
+    bool ok = apply_delta(target, delta_path, rebuilt_path);
+    if (ok) {
+        fs::rename(rebuilt_path, target, ec);
+        ok = !ec;
+    }
+    if (!ok) {
+        std::cerr << "Error reconstruyendo " << target << " desde su delta." << std::endl;
+        fs::remove(rebuilt_path, ec);
+    }
+    fs::remove(delta_path, ec);
+    return ok;
+}
+
+// En un respaldo incremental, borra los archivos que ya no existían al respaldar.
+// Los incrementales se restauran en orden sobre la restauración del respaldo completo.
+static bool apply_deletions(const std::string& metadata_text, const fs::path& dest_path) {
+    try {
+        json metadata = json::parse(metadata_text);
+        for (const auto& deleted : metadata["deleted"]) {
+            fs::path relative = safe_relative_path(deleted.get<std::string>());
+            if (relative.empty()) {
+                continue; // Nunca borrar fuera del destino
+            }
+            std::error_code ec;
+            fs::remove_all(dest_path / relative, ec);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error aplicando los borrados del respaldo incremental: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Extrae la entrada 'index' del ZIP en 'entry_path'. Se leen los datos comprimidos tal cual
+// y se descomprimen con el codec que indique el método de la entrada (deflate, zstd, lz4...).
+// 'buffer' es el de lectura del hilo (EXTRACT_READ_SIZE), reutilizado entre entradas.
+static bool extract_entry(zip_t* archive, zip_int64_t index, const zip_stat_t& zs, const fs::path& entry_path,
+                          IoEngine& engine, std::vector<char>& buffer) {
+    std::unique_ptr<Decoder> decoder = make_decoder(zs.comp_method);
+    if (!decoder) {
+        std::cerr << "Método de compresión no soportado (" << zs.comp_method << ") en: " << zs.name << std::endl;
+        return false;
+    }
+    zip_file_t* zf = zip_fopen_index(archive, index, ZIP_FL_COMPRESSED);
+    if (!zf) {
+        std::cerr << "Error abriendo archivo dentro del ZIP: " << zs.name << std::endl;
+        return false;
+    }
+
+    // Asegurarse de que el directorio padre exista para el archivo
+    try {
+        fs::create_directories(entry_path.parent_path());
+    } catch (const std::exception& e) {
+        std::cerr << "Error creando directorio padre para " << entry_path << ": " << e.what() << std::endl;
+        zip_fclose(zf);
+        return false;
+    }
+
+    IoFileWriter outfile(engine);
+    if (!outfile.open(entry_path)) {
+        std::cerr << "Error creando archivo de salida: " << entry_path << std::endl;
+        zip_fclose(zf);
+        return false;
+    }
+
+    zip_int64_t read_bytes; // Cambiado de zip_int66_t a zip_int64_t
+    uLong crc = crc32(0L, Z_NULL, 0);
+    auto sink = [&](const unsigned char* data, size_t len) {
+        crc = crc32(crc, data, len);
+        return outfile.write(data, len);
+    };
+    bool entry_ok = true;
+    while ((read_bytes = zip_fread(zf, buffer.data(), buffer.size())) > 0) {
+        if (!decoder->feed(reinterpret_cast<unsigned char*>(buffer.data()), read_bytes, sink)) {
+            entry_ok = false;
+            break;
+        }
+    }
+    if (read_bytes < 0 || !decoder->finish() || crc != zs.crc) {
+        entry_ok = false;
+    }
+    if (!entry_ok) {
+        std::cerr << "Error descomprimiendo (datos corruptos o CRC incorrecto): " << zs.name << std::endl;
+    }
+
+    if (!outfile.close() && entry_ok) {
+        std::cerr << "Error escribiendo " << entry_path << ": " << std::strerror(outfile.error()) << std::endl;
+        entry_ok = false;
+    }
+    zip_fclose(zf);
+    return entry_ok;
+}
+
+// Estado de cada tarea de extracción: su handle del ZIP, su motor de escritura y su buffer.
+struct ExtractWorker {
+    zip_t* archive = nullptr;
+    IoEngine engine{RESTORE_WRITE_BUFFER_SIZE, RESTORE_WRITE_BUFFERS};
+    std::vector<char> buffer = std::vector<char>(EXTRACT_READ_SIZE);
+
+    explicit ExtractWorker(const std::string& zip_path) {
+        int err = 0;
+        archive = zip_open(zip_path.c_str(), ZIP_RDONLY, &err);
+        if (!archive) {
+            std::cerr << "Error abriendo archivo ZIP en un hilo de extracción (Error: " << err << ")" << std::endl;
+        }
+    }
+    ~ExtractWorker() {
+        if (archive) zip_discard(archive); // Solo lectura: no hay nada que escribir al cerrar
+    }
+};
+
 bool decompress_file(const fs::path& zip_file_path, const fs::path& dest_path) {
     int err = 0;
-    zip_t* archive = zip_open(zip_file_path.string().c_str(), 0, &err);
+    zip_t* archive = zip_open(zip_file_path.string().c_str(), ZIP_RDONLY, &err);
     if (!archive) {
         std::cerr << "Error abriendo archivo ZIP para descompresión: " << zip_file_path << " (Error: " << err << ")" << std::endl;
         show_message("Error: No se pudo abrir el archivo ZIP para descompresión.");
         return false;
     }
 
+    // Los respaldos creados por este programa registran el codec en el comentario del ZIP.
+    const char* comment = zip_get_archive_comment(archive, nullptr, 0);
+    if (comment) {
+        std::cout << "Metadatos del respaldo: " << comment << std::endl;
+    }
+
+    // Primera pasada, en un solo hilo: clasificar las entradas y crear los directorios.
     bool success = true;
-    #pragma omp parallel for
-    for (int i = 0; i < zip_get_num_entries(archive, 0); ++i) {
+    std::vector<zip_int64_t> delta_entries;
+    struct FileEntry {
+        zip_int64_t index;
+        zip_uint64_t comp_size;
+        fs::path target;
+    };
+    std::vector<FileEntry> files;
+    zip_int64_t num_entries = zip_get_num_entries(archive, 0);
+    for (zip_int64_t i = 0; i < num_entries; ++i) {
         zip_stat_t zs;
         if (zip_stat_index(archive, i, 0, &zs) < 0) {
             std::cerr << "Error obteniendo estadísticas del archivo en ZIP." << std::endl;
@@ -198,7 +673,22 @@ bool decompress_file(const fs::path& zip_file_path, const fs::path& dest_path) {
             continue;
         }
 
-        fs::path entry_path = dest_path / zs.name;
+        // Los metadatos y deltas del programa no se extraen aquí: se aplican después,
+        // cuando la versión anterior de cada archivo ya está en su sitio.
+        if (std::string(zs.name).rfind(".backup_tool/", 0) == 0) {
+            if (std::string(zs.name).rfind(DELTA_ENTRY_PREFIX, 0) == 0) {
+                delta_entries.push_back(i);
+            }
+            continue;
+        }
+
+        fs::path relative = safe_relative_path(zs.name);
+        if (relative.empty()) {
+            std::cerr << "Entrada fuera de la carpeta de destino: " << zs.name << std::endl;
+            success = false;
+            continue;
+        }
+        fs::path entry_path = dest_path / relative;
 
         // Si es un directorio, crearlo
         if (zs.name[strlen(zs.name) - 1] == '/') { // strlen requiere <cstring>
@@ -210,43 +700,205 @@ bool decompress_file(const fs::path& zip_file_path, const fs::path& dest_path) {
             }
             continue;
         }
+        files.push_back({i, zs.comp_size, entry_path});
+    }
+
+    // Los más grandes primero: así el último archivo grande no queda solo al final.
+    std::stable_sort(files.begin(), files.end(),
+                     [](const FileEntry& a, const FileEntry& b) { return a.comp_size > b.comp_size; });
 
+    // libzip no admite leer de un mismo zip_t desde varios hilos: cada tarea abre el archivo
+    // por su cuenta (solo lectura) y toma entradas de la lista según va terminando.
+    const std::string zip_path = zip_file_path.string();
+    std::atomic<bool> all_extracted{true};
+    parallel_for(Lane::Cpu, files.size(), [&] {
+        return std::make_unique<ExtractWorker>(zip_path);
+    }, [&](std::unique_ptr<ExtractWorker>& worker, size_t k) {
+        zip_stat_t zs;
+        if (!worker->archive || zip_stat_index(worker->archive, files[k].index, 0, &zs) < 0) {
+            all_extracted = false;
+            return;
+        }
         // Si es un archivo, extraerlo
-        zip_file_t* zf = zip_fopen_index(archive, i, 0);
-        if (!zf) {
-            std::cerr << "Error abriendo archivo dentro del ZIP: " << zs.name << std::endl;
+        if (!extract_entry(worker->archive, files[k].index, zs, files[k].target, worker->engine, worker->buffer)) {
+            all_extracted = false;
+        }
+    });
+    if (!all_extracted) {
+        success = false;
+    }
+
+    // Archivos grandes respaldados como delta: se reconstruyen sobre la versión ya restaurada.
+    IoEngine engine(RESTORE_WRITE_BUFFER_SIZE, RESTORE_WRITE_BUFFERS);
+    std::vector<char> buffer(EXTRACT_READ_SIZE);
+    for (zip_int64_t index : delta_entries) {
+        zip_stat_t zs;
+        if (zip_stat_index(archive, index, 0, &zs) < 0) {
             success = false;
             continue;
         }
-
-        // Asegurarse de que el directorio padre exista para el archivo
-        try {
-            fs::create_directories(entry_path.parent_path());
-        } catch (const std::exception& e) {
-            std::cerr << "Error creando directorio padre para " << entry_path << ": " << e.what() << std::endl;
+        fs::path relative = safe_relative_path(std::string(zs.name).substr(DELTA_ENTRY_PREFIX.size()));
+        if (relative.empty()) {
+            std::cerr << "Entrada fuera de la carpeta de destino: " << zs.name << std::endl;
             success = false;
-            zip_fclose(zf);
             continue;
         }
+        fs::path target = dest_path / relative;
+        fs::path delta_path = target.string() + ".btdelta";
+        if (!extract_entry(archive, index, zs, delta_path, engine, buffer) || !rebuild_from_delta(target, delta_path)) {
+            std::error_code ec;
+            fs::remove(delta_path, ec);
+            success = false;
+        }
+    }
 
-        std::ofstream outfile(entry_path, std::ios::binary);
-        if (!outfile.is_open()) {
-            std::cerr << "Error creando archivo de salida: " << entry_path << std::endl;
+    // En un respaldo incremental, borrar los archivos que ya no existían al respaldar.
+    zip_int64_t metadata_index = zip_name_locate(archive, INCREMENTAL_METADATA_ENTRY.c_str(), 0);
+    if (metadata_index >= 0) {
+        std::string text;
+        zip_file_t* zf = zip_fopen_index(archive, metadata_index, 0);
+        zip_int64_t read_bytes;
+        while (zf && (read_bytes = zip_fread(zf, buffer.data(), buffer.size())) > 0) {
+            text.append(buffer.data(), read_bytes);
+        }
+        if (zf) zip_fclose(zf);
+        if (!apply_deletions(text, dest_path)) {
             success = false;
-            zip_fclose(zf);
-            continue;
         }
+    }
 
-        char buffer[4096];
-        zip_int64_t read_bytes; // Cambiado de zip_int66_t a zip_int64_t
-        while ((read_bytes = zip_fread(zf, buffer, sizeof(buffer))) > 0) {
-            outfile.write(buffer, read_bytes);
+    zip_close(archive);
+    return success;
+}
+
+bool decompress_stream(const ZipSource& source, const fs::path& dest_path) {
+    enum class Target { Skip, File, Delta, Metadata };
+    Target target = Target::Skip;
+    fs::path entry_path;
+    IoEngine engine(RESTORE_WRITE_BUFFER_SIZE, RESTORE_WRITE_BUFFERS);
+    IoFileWriter outfile(engine);
+    std::string metadata_text;
+    std::unique_ptr<Decoder> decoder;
+    uLong crc = 0;
+    bool success = true;
+    // Deltas ya extraídos (archivo de destino y delta), para reconstruirlos al final como en
+    // decompress_file.
+    std::vector<std::pair<fs::path, fs::path>> deltas;
+
+    auto sink = [&](const unsigned char* data, size_t len) {
+        crc = crc32(crc, data, len);
+        if (target == Target::Metadata) {
+            metadata_text.append(reinterpret_cast<const char*>(data), len);
+            return true;
+        }
+        return outfile.write(data, len);
+    };
+    // Una entrada que no se puede extraer se salta y el resto del ZIP sigue.
+    auto skip_entry = [&](const std::string& reason) {
+        std::cerr << reason << std::endl;
+        success = false;
+        if (target == Target::Delta) {
+            std::error_code ec;
+            fs::remove(entry_path, ec);
         }
+        target = Target::Skip;
+        decoder.reset();
+        if (outfile.is_open()) outfile.close();
+        return true;
+    };
 
-        outfile.close();
-        zip_fclose(zf);
+    ZipStreamReader reader(
+        [&](const ZipStreamEntry& entry) {
+            target = Target::Skip;
+            crc = crc32(0L, Z_NULL, 0);
+            if (entry.name == INCREMENTAL_METADATA_ENTRY) {
+                target = Target::Metadata;
+                metadata_text.clear();
+            } else if (entry.name.rfind(DELTA_ENTRY_PREFIX, 0) == 0) {
+                fs::path relative = safe_relative_path(entry.name.substr(DELTA_ENTRY_PREFIX.size()));
+                if (relative.empty()) {
+                    return skip_entry("Entrada fuera de la carpeta de destino: " + entry.name);
+                }
+                entry_path = (dest_path / relative).string() + ".btdelta";
+                target = Target::Delta;
+            } else if (entry.name.rfind(".backup_tool/", 0) == 0) {
+                return true;
+            } else {
+                fs::path relative = safe_relative_path(entry.name);
+                if (relative.empty()) {
+                    return skip_entry("Entrada fuera de la carpeta de destino: " + entry.name);
+                }
+                entry_path = dest_path / relative;
+                if (entry.name.back() == '/') {
+                    std::error_code ec;
+                    fs::create_directories(entry_path, ec);
+                    if (ec) skip_entry("Error creando directorio: " + entry_path.string() + " - " + ec.message());
+                    return true;
+                }
+                target = Target::File;
+            }
+
+            decoder = make_decoder(entry.method);
+            if (!decoder) {
+                return skip_entry("Método de compresión no soportado (" + std::to_string(entry.method) +
+                                  ") en: " + entry.name);
+            }
+            if (target != Target::Metadata) {
+                std::error_code ec;
+                fs::create_directories(entry_path.parent_path(), ec);
+                if (!outfile.open(entry_path)) {
+                    return skip_entry("Error creando archivo de salida: " + entry_path.string());
+                }
+            }
+            return true;
+        },
+        [&](const unsigned char* data, size_t len) {
+            if (target != Target::Skip && !decoder->feed(data, len, sink)) {
+                skip_entry("Error descomprimiendo (datos corruptos): " + entry_path.string());
+            }
+            return true;
+        },
+        [&](const ZipStreamEntry& entry) {
+            if (target == Target::Skip) return true;
+            bool entry_ok = decoder->finish() && crc == entry.crc;
+            if (outfile.is_open()) {
+                entry_ok = outfile.close() && entry_ok;
+            }
+            if (!entry_ok) {
+                skip_entry("Error descomprimiendo (datos corruptos o CRC incorrecto): " + entry.name);
+                return true;
+            } else if (target == Target::Delta) {
+                fs::path relative = safe_relative_path(entry.name.substr(DELTA_ENTRY_PREFIX.size()));
+                deltas.emplace_back(dest_path / relative, entry_path);
+            }
+            target = Target::Skip;
+            decoder.reset();
+            return true;
+        });
+
+    std::vector<unsigned char> buffer(STREAM_READ_SIZE);
+    size_t n;
+    while ((n = source(buffer.data(), buffer.size())) > 0) {
+        if (!reader.feed(buffer.data(), n)) break;
+    }
+    if (!reader.finish()) {
+        std::cerr << "Error leyendo el respaldo: " << reader.error() << std::endl;
+        if (outfile.is_open()) outfile.close();
+        for (const auto& delta : deltas) {
+            std::error_code ec;
+            fs::remove(delta.second, ec);
+        }
+        return false;
     }
 
-    zip_close(archive);
+    // Deltas y borrados solo se aplican con el respaldo completo, igual que en decompress_file.
+    for (const auto& delta : deltas) {
+        if (!rebuild_from_delta(delta.first, delta.second)) {
+            success = false;
+        }
+    }
+    if (!metadata_text.empty() && !apply_deletions(metadata_text, dest_path)) {
+        success = false;
+    }
     return success;
 }
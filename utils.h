@@ -1,6 +1,13 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include "Codec.h"
+#include "Compressor.h"
+#include "CopyEngine.h"
+#include "DirectoryScanner.h"
+#include "FileManifest.h"
+#include "PageCache.h"
+#include <functional>
 #include <string>
 #include <vector>
 #include <filesystem> // Para std::filesystem::path
@@ -10,13 +17,67 @@ namespace fs = std::filesystem;
 void show_message(const std::string& message);
 std::vector<std::string> select_folders();
 std::string choose_destination_type();
-bool copy_directory(const fs::path& source, const fs::path& destination);
+// Copia el contenido de 'source' en 'destination' con copy_tree (reflink, copy_file_range,
+// sendfile o read/write, en paralelo). Si 'report' no es nulo acumula qué método se usó.
+bool copy_directory(const fs::path& source, const fs::path& destination, CopyReport* report = nullptr);
 void compress_folder(const fs::path& folder, const fs::path& dest_path);
+// Lista los archivos de las carpetas a respaldar con su nombre dentro del respaldo
+// ('carpeta/ruta/relativa'). Lanza fs::filesystem_error si no se puede recorrer una carpeta.
+// Si 'roots' no es nulo recibe el nombre con el que quedó cada carpeta, y si 'scan' no es nulo,
+// los contadores del recorrido.
+std::vector<ArchiveItem> collect_backup_items(const std::vector<std::string>& folders,
+                                              std::vector<std::string>* roots = nullptr,
+                                              ScanStats* scan = nullptr);
+
+// Estado para los respaldos incrementales. 'previous' es el manifiesto del respaldo anterior;
+// si 'incremental' es true solo se respaldan los archivos nuevos o modificados respecto a él
+// (los grandes como delta por bloques) y se registran los borrados. En 'next' queda el
+// manifiesto a guardar con commit_incremental cuando el respaldo esté confirmado.
+struct IncrementalState {
+    FileManifest previous;
+    bool incremental = false;
+    std::vector<FileState> next;
+    // Firmas por bloques de los archivos grandes (para los deltas): las nuevas quedan con
+    // extensión '.new' hasta commit_incremental.
+    fs::path signature_dir;
+    std::vector<fs::path> pending_signatures;
+    std::vector<fs::path> obsolete_signatures;
+};
+
+// Comprime las carpetas indicadas directamente desde su ubicación original en 'output' (un archivo
+// o un sink), sin copiarlas antes a una carpeta temporal. Cada carpeta queda bajo su propio nombre.
+// Si 'stats' no es nulo se devuelven las estadísticas de compresión.
+bool compress_folders(const std::vector<std::string>& folders, const ArchiveOutput& output,
+                      const CodecOptions& codec = CodecOptions(), BackupStats* stats = nullptr,
+                      IncrementalState* incremental = nullptr);
+
+// Guarda el manifiesto y las firmas del respaldo. Solo se llama cuando el respaldo está
+// confirmado (escrito en disco o aceptado por el servidor).
+bool commit_incremental(const fs::path& manifest_path, IncrementalState& state);
+
+// Tipo de respaldo: completo o solo los cambios desde el anterior.
+enum class BackupMode { Full, Incremental };
+BackupMode choose_backup_mode();
+// Carga el manifiesto 'manifest_path' en 'state'. Si se pidió un incremental y no hay
+// manifiesto anterior, avisa y el respaldo se hace completo.
+void prepare_incremental(const fs::path& manifest_path, BackupMode mode, IncrementalState& state);
+// Pregunta al usuario con qué codec comprimir el respaldo (y el nivel, para zstd).
+CodecOptions choose_codec();
+// Pregunta cómo deben usar la caché de páginas las lecturas del respaldo (ver PageCache.h).
+CachePolicy choose_cache_policy();
 
 // --- Nuevas funciones para la restauración ---
 std::string ask_restore_destination_folder();
 std::vector<std::string> select_files_from_list(const std::vector<std::string>& file_list);
 std::string select_zip_file();
 bool decompress_file(const fs::path& zip_file_path, const fs::path& dest_path);
+// Ruta de una entrada de un respaldo relativa al destino, o vacía si intenta salir de él
+// (absoluta o con '..'). Toda ruta que venga de un respaldo pasa por aquí antes de escribir.
+fs::path safe_relative_path(const std::string& name);
+// Fuente de bytes de un ZIP: copia hasta 'max' bytes en 'out' y devuelve 0 al terminar.
+using ZipSource = std::function<size_t(void* out, size_t max)>;
+// Como decompress_file, pero lee el ZIP de principio a fin desde 'source' (por ejemplo, una
+// descarga en curso) y extrae cada archivo a medida que llega, sin archivo temporal.
+bool decompress_stream(const ZipSource& source, const fs::path& dest_path);
 
 #endif // UTILS_H
\ No newline at end of file